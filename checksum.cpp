@@ -0,0 +1,114 @@
+#include "checksum.h"
+
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define TC_CRC32C_X86
+#include <nmmintrin.h>
+#endif
+
+namespace checksum {
+
+	namespace {
+		constexpr uint32_t CRC32C_POLYNOMIAL = 0x82F63B78;
+
+		using CrcTables = std::array<std::array<uint32_t, 256>, 8>;
+
+		CrcTables MakeCrcTables() {
+			CrcTables tables{};
+			for (uint32_t byte = 0; byte < 256; ++byte) {
+				uint32_t crc = byte;
+				for (int bit = 0; bit < 8; ++bit) {
+					crc = (crc >> 1) ^ (crc & 1 ? CRC32C_POLYNOMIAL : 0);
+				}
+				tables[0][byte] = crc;
+			}
+			//table k advances a byte through k more zero bytes
+			for (uint32_t byte = 0; byte < 256; ++byte) {
+				for (size_t k = 1; k < tables.size(); ++k) {
+					const uint32_t previous = tables[k - 1][byte];
+					tables[k][byte] = (previous >> 8) ^ tables[0][previous & 0xFF];
+				}
+			}
+			return tables;
+		}
+
+		uint32_t Crc32cSoftware(const unsigned char* data, size_t size, uint32_t crc) {
+			static const CrcTables tables = MakeCrcTables();
+			for (; size >= 8; data += 8, size -= 8) {
+				uint32_t low;
+				uint32_t high;
+				std::memcpy(&low, data, sizeof(low));
+				std::memcpy(&high, data + 4, sizeof(high));
+				low ^= crc;
+				crc = tables[7][low & 0xFF] ^ tables[6][(low >> 8) & 0xFF] ^ tables[5][(low >> 16) & 0xFF] ^ tables[4][low >> 24]
+					^ tables[3][high & 0xFF] ^ tables[2][(high >> 8) & 0xFF] ^ tables[1][(high >> 16) & 0xFF] ^ tables[0][high >> 24];
+			}
+			for (; size > 0; ++data, --size) {
+				crc = (crc >> 8) ^ tables[0][(crc ^ *data) & 0xFF];
+			}
+			return crc;
+		}
+
+#ifdef TC_CRC32C_X86
+		__attribute__((target("sse4.2")))
+		uint32_t Crc32cHardware(const unsigned char* data, size_t size, uint32_t crc) {
+			uint64_t crc64 = crc;
+			for (; size >= 8; data += 8, size -= 8) {
+				uint64_t word;
+				std::memcpy(&word, data, sizeof(word));
+				crc64 = _mm_crc32_u64(crc64, word);
+			}
+			crc = static_cast<uint32_t>(crc64);
+			for (; size > 0; ++data, --size) {
+				crc = _mm_crc32_u8(crc, *data);
+			}
+			return crc;
+		}
+
+		bool HasHardwareCrc() {
+			static const bool supported = __builtin_cpu_supports("sse4.2");
+			return supported;
+		}
+#endif
+
+		uint64_t Mix(uint64_t value) {
+			value ^= value >> 33;
+			value *= 0xFF51AFD7ED558CCDull;
+			value ^= value >> 33;
+			value *= 0xC4CEB9FE1A85EC53ull;
+			value ^= value >> 33;
+			return value;
+		}
+	}
+
+	uint32_t Crc32c(std::string_view data, uint32_t crc) {
+		const auto* bytes = reinterpret_cast<const unsigned char*>(data.data());
+		crc = ~crc;
+#ifdef TC_CRC32C_X86
+		if (HasHardwareCrc()) {
+			return ~Crc32cHardware(bytes, data.size(), crc);
+		}
+#endif
+		return ~Crc32cSoftware(bytes, data.size(), crc);
+	}
+
+	uint64_t Hash64(std::string_view data, uint64_t seed) {
+		constexpr uint64_t MULTIPLIER = 0x9E3779B97F4A7C15ull;
+		uint64_t hash = seed ^ (data.size() * MULTIPLIER);
+		size_t pos = 0;
+		for (; data.size() - pos >= 8; pos += 8) {
+			uint64_t word;
+			std::memcpy(&word, data.data() + pos, sizeof(word));
+			hash = (hash ^ Mix(word)) * MULTIPLIER;
+			hash = (hash << 31) | (hash >> 33);
+		}
+		if (pos < data.size()) {
+			uint64_t word = 0;
+			std::memcpy(&word, data.data() + pos, data.size() - pos);
+			hash = (hash ^ Mix(word)) * MULTIPLIER;
+		}
+		return Mix(hash);
+	}
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace checksum {
+
+	// CRC32C (полином Кастаньоли). Если процессор поддерживает SSE 4.2, считается инструкцией crc32,
+	// иначе таблицами по 8 байт за шаг. crc - значение для предыдущих данных, чтобы считать по частям
+	uint32_t Crc32c(std::string_view data, uint32_t crc = 0);
+
+	// Некриптографический 64-битный хеш для ключей кешей: одинаковые данные дают одинаковый хеш
+	// на любой машине с тем же порядком байт
+	uint64_t Hash64(std::string_view data, uint64_t seed = 0);
+}
@@ -0,0 +1,268 @@
+#include "compression.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#ifdef TC_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace compression {
+
+	namespace {
+		// Встроенный кодек - LZ77 в духе LZ4: последовательности из литералов и ссылки назад.
+		// Токен: старшие 4 бита - число литералов, младшие - длина совпадения минус MIN_MATCH,
+		// значение 15 продолжается байтами по 255. За литералами идёт смещение ссылки (2 байта)
+		// и продолжение длины совпадения. Последняя последовательность блока состоит только из литералов
+		constexpr size_t MIN_MATCH = 4;
+		constexpr size_t MAX_OFFSET = 0xFFFF;
+		constexpr int HASH_BITS = 14;
+
+		uint32_t Read32(const char* data) {
+			uint32_t value;
+			std::memcpy(&value, data, sizeof(value));
+			return value;
+		}
+
+		uint32_t Hash(uint32_t value) {
+			return (value * 2654435761u) >> (32 - HASH_BITS);
+		}
+
+		void WriteLength(std::string& out, size_t length) {
+			for (; length >= 255; length -= 255) {
+				out.push_back(static_cast<char>(255));
+			}
+			out.push_back(static_cast<char>(length));
+		}
+
+		void WriteSequence(std::string& out, std::string_view literals, size_t offset, size_t match_length) {
+			const size_t match_code = match_length == 0 ? 0 : match_length - MIN_MATCH;
+			const auto token = static_cast<uint8_t>((std::min<size_t>(literals.size(), 15) << 4) | std::min<size_t>(match_code, 15));
+			out.push_back(static_cast<char>(token));
+			if (literals.size() >= 15) {
+				WriteLength(out, literals.size() - 15);
+			}
+			out.append(literals);
+			if (match_length == 0) {
+				return;
+			}
+			out.push_back(static_cast<char>(offset & 0xFF));
+			out.push_back(static_cast<char>(offset >> 8));
+			if (match_code >= 15) {
+				WriteLength(out, match_code - 15);
+			}
+		}
+
+		std::string CompressLz(std::string_view data) {
+			std::string out;
+			out.reserve(data.size() / 2);
+			std::vector<int64_t> table(size_t{ 1 } << HASH_BITS, -1);
+
+			size_t anchor = 0;
+			size_t pos = 0;
+			while (data.size() >= MIN_MATCH && pos <= data.size() - MIN_MATCH) {
+				const uint32_t value = Read32(data.data() + pos);
+				int64_t& slot = table[Hash(value)];
+				const int64_t candidate = slot;
+				slot = static_cast<int64_t>(pos);
+				if (candidate < 0 || pos - candidate > MAX_OFFSET || Read32(data.data() + candidate) != value) {
+					++pos;
+					continue;
+				}
+
+				size_t length = MIN_MATCH;
+				while (pos + length < data.size() && data[candidate + length] == data[pos + length]) {
+					++length;
+				}
+				WriteSequence(out, data.substr(anchor, pos - anchor), pos - candidate, length);
+				pos += length;
+				anchor = pos;
+			}
+			WriteSequence(out, data.substr(anchor), 0, 0);
+			return out;
+		}
+
+		size_t ReadLength(std::string_view data, size_t& pos) {
+			size_t length = 0;
+			while (true) {
+				if (pos >= data.size()) {
+					throw std::runtime_error("Corrupted compressed block");
+				}
+				const auto byte = static_cast<uint8_t>(data[pos++]);
+				length += byte;
+				if (byte != 255) {
+					return length;
+				}
+			}
+		}
+
+		void DecompressLz(std::string_view data, char* output, size_t output_size) {
+			size_t pos = 0;
+			size_t produced = 0;
+			while (pos < data.size()) {
+				const auto token = static_cast<uint8_t>(data[pos++]);
+				size_t literals = token >> 4;
+				if (literals == 15) {
+					literals += ReadLength(data, pos);
+				}
+				if (literals > data.size() - pos || literals > output_size - produced) {
+					throw std::runtime_error("Corrupted compressed block");
+				}
+				std::memcpy(output + produced, data.data() + pos, literals);
+				pos += literals;
+				produced += literals;
+				if (pos == data.size()) {
+					break;
+				}
+
+				if (data.size() - pos < 2) {
+					throw std::runtime_error("Corrupted compressed block");
+				}
+				const size_t offset = static_cast<uint8_t>(data[pos]) | (static_cast<size_t>(static_cast<uint8_t>(data[pos + 1])) << 8);
+				pos += 2;
+				size_t length = token & 0x0F;
+				if (length == 15) {
+					length += ReadLength(data, pos);
+				}
+				length += MIN_MATCH;
+				if (offset == 0 || offset > produced || length > output_size - produced) {
+					throw std::runtime_error("Corrupted compressed block");
+				}
+				//the source may overlap the destination, so the copy goes byte by byte
+				const char* source = output + produced - offset;
+				for (size_t i = 0; i < length; ++i) {
+					output[produced + i] = source[i];
+				}
+				produced += length;
+			}
+			if (produced != output_size) {
+				throw std::runtime_error("Corrupted compressed block");
+			}
+		}
+
+		std::string CompressBlock(std::string_view block, Codec codec) {
+#ifdef TC_HAVE_ZSTD
+			if (codec == Codec::ZSTD) {
+				std::string out(ZSTD_compressBound(block.size()), '\0');
+				const size_t size = ZSTD_compress(out.data(), out.size(), block.data(), block.size(), 3);
+				if (ZSTD_isError(size)) {
+					return {};
+				}
+				out.resize(size);
+				return out;
+			}
+#endif
+			static_cast<void>(codec);
+			return CompressLz(block);
+		}
+
+		void DecompressBlock(Codec codec, std::string_view block, char* output, size_t output_size) {
+			switch (codec) {
+			case Codec::STORED:
+				if (block.size() != output_size) {
+					throw std::runtime_error("Corrupted compressed block");
+				}
+				std::memcpy(output, block.data(), block.size());
+				return;
+			case Codec::LZ:
+				DecompressLz(block, output, output_size);
+				return;
+			case Codec::ZSTD:
+#ifdef TC_HAVE_ZSTD
+				if (ZSTD_isError(ZSTD_decompress(output, output_size, block.data(), block.size()))) {
+					throw std::runtime_error("Corrupted compressed block");
+				}
+				return;
+#else
+				throw std::runtime_error("Block is compressed with zstd, which this build does not support");
+#endif
+			}
+			throw std::runtime_error("Unknown compression codec");
+		}
+	}
+
+	Codec GetDefaultCodec() {
+#ifdef TC_HAVE_ZSTD
+		return Codec::ZSTD;
+#else
+		return Codec::LZ;
+#endif
+	}
+
+	std::string Compress(std::string_view data) {
+		const Codec codec = GetDefaultCodec();
+		std::string out;
+		WriteVarint(out, data.size());
+		for (size_t begin = 0; begin < data.size(); begin += BLOCK_SIZE) {
+			const std::string_view block = data.substr(begin, BLOCK_SIZE);
+			std::string compressed = CompressBlock(block, codec);
+			const bool stored = compressed.empty() || compressed.size() >= block.size();
+			out.push_back(static_cast<char>(stored ? Codec::STORED : codec));
+			WriteVarint(out, stored ? block.size() : compressed.size());
+			out.append(stored ? block : std::string_view(compressed));
+		}
+		return out;
+	}
+
+	size_t GetDecompressedSize(std::string_view data) {
+		size_t pos = 0;
+		const auto size = static_cast<size_t>(ReadVarint(data, pos));
+		//every block takes at least two bytes, so a larger size can only come from corrupted data
+		if (size / BLOCK_SIZE > data.size()) {
+			throw std::runtime_error("Corrupted compressed data");
+		}
+		return size;
+	}
+
+	void DecompressTo(std::string_view data, char* output) {
+		const size_t size = GetDecompressedSize(data);
+		size_t pos = 0;
+		ReadVarint(data, pos);
+		for (size_t begin = 0; begin < size; begin += BLOCK_SIZE) {
+			if (pos >= data.size()) {
+				throw std::runtime_error("Corrupted compressed data");
+			}
+			const auto codec = static_cast<Codec>(data[pos++]);
+			const auto block_size = static_cast<size_t>(ReadVarint(data, pos));
+			if (block_size > data.size() - pos) {
+				throw std::runtime_error("Corrupted compressed data");
+			}
+			DecompressBlock(codec, data.substr(pos, block_size), output + begin, std::min(BLOCK_SIZE, size - begin));
+			pos += block_size;
+		}
+		if (pos != data.size()) {
+			throw std::runtime_error("Corrupted compressed data");
+		}
+	}
+
+	std::string Decompress(std::string_view data) {
+		std::string out(GetDecompressedSize(data), '\0');
+		DecompressTo(data, out.data());
+		return out;
+	}
+
+	void WriteVarint(std::string& out, uint64_t value) {
+		while (value >= 0x80) {
+			out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+			value >>= 7;
+		}
+		out.push_back(static_cast<char>(value));
+	}
+
+	uint64_t ReadVarint(std::string_view data, size_t& pos) {
+		uint64_t value = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			if (pos >= data.size()) {
+				break;
+			}
+			const auto byte = static_cast<uint8_t>(data[pos++]);
+			value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0) {
+				return value;
+			}
+		}
+		throw std::runtime_error("Corrupted varint");
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace compression {
+
+	// Сжатие данных независимыми блоками по BLOCK_SIZE байт. Кодек выбирается для каждого блока:
+	// zstd, если программа собрана с ним, иначе встроенный LZ77; блок, который не сжимается,
+	// хранится как есть.
+	//
+	// Формат: varint размера исходных данных, затем блоки - байт кодека, varint размера
+	// сжатого блока и сами данные. Исходный размер каждого блока, кроме последнего, равен BLOCK_SIZE
+	inline constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+	enum class Codec : uint8_t {
+		STORED = 0,
+		LZ = 1,
+		ZSTD = 2,
+	};
+
+	// Кодек, которым Compress сжимает блоки в этой сборке
+	Codec GetDefaultCodec();
+
+	std::string Compress(std::string_view data);
+	// Размер данных после распаковки, сами блоки не читаются
+	size_t GetDecompressedSize(std::string_view data);
+	// Распаковывает данные в буфер размера GetDecompressedSize(data). Бросает std::runtime_error,
+	// если данные повреждены или блок сжат кодеком, которого нет в этой сборке
+	void DecompressTo(std::string_view data, char* output);
+	std::string Decompress(std::string_view data);
+
+	void WriteVarint(std::string& out, uint64_t value);
+	// Бросает std::runtime_error, если число обрывается в конце data
+	uint64_t ReadVarint(std::string_view data, size_t& pos);
+
+	// Отображение знаковых чисел в беззнаковые, чтобы малые по модулю разности занимали мало байт
+	inline uint64_t ZigZag(int64_t value) {
+		return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+	}
+
+	inline int64_t UnZigZag(uint64_t value) {
+		return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+	}
+}
@@ -0,0 +1,196 @@
+#include "delta.h"
+#include "flat_base.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+
+using namespace std::literals;
+
+namespace delta {
+
+	namespace {
+		constexpr uint32_t NO_PREVIOUS = transport_router::TRouter::NO_PREVIOUS;
+
+		// Каталог после изменений и соответствие его объектов объектам базы
+		struct Rebuild {
+			trans_ctl::TransportCatalogue catalogue;
+			// Индекс - id остановки базы, значение - её id в новом каталоге или NO_PREVIOUS, если удалена
+			std::vector<uint32_t> new_stop_ids;
+			// Индекс - id маршрута в новом каталоге, значение - id того же маршрута в базе
+			// или NO_PREVIOUS, если маршрут нужно пересчитать
+			std::vector<uint32_t> previous_bus_ids;
+		};
+
+		// Последнее изменение с каждым именем
+		template <typename Change>
+		std::unordered_map<std::string_view, const Change*> IndexByName(const std::vector<Change>& changes) {
+			std::unordered_map<std::string_view, const Change*> index;
+			for (const auto& change : changes) {
+				index[change.name] = &change;
+			}
+			return index;
+		}
+
+		trans_ctl::Stop* GetStop(const trans_ctl::TransportCatalogue& catalogue, uint32_t id) {
+			//the deque keeps addresses stable, buses of the catalogue point into it
+			return const_cast<trans_ctl::Stop*>(&catalogue.GetStopById(id));
+		}
+
+		trans_ctl::Stop* FindStop(const trans_ctl::TransportCatalogue& catalogue, std::string_view name, std::string_view context) {
+			trans_ctl::Stop* stop = catalogue.FindStop(name);
+			if (stop == nullptr) {
+				throw std::runtime_error("Unknown stop "s + std::string(name) + " in "s + std::string(context));
+			}
+			return stop;
+		}
+
+		void AddStops(const trans_ctl::TransportCatalogue& base, const Changes& changes, Rebuild& result, std::vector<bool>& touched_stops) {
+			std::vector<bool> removed(base.GetStopsCount(), false);
+			for (const auto& name : changes.removed_stops) {
+				removed[FindStop(base, name, "removed stops"sv)->id] = true;
+			}
+
+			const auto changed = IndexByName(changes.stops);
+			result.new_stop_ids.assign(base.GetStopsCount(), NO_PREVIOUS);
+			for (const auto& stop : base.GetStops()) {
+				if (removed[stop.id]) {
+					continue;
+				}
+				trans_ctl::Stop new_stop{ stop.name, stop.coordinates };
+				if (const auto it = changed.find(stop.name); it != changed.end()) {
+					new_stop.coordinates = it->second->coordinates;
+					touched_stops.push_back(true);
+				}
+				else {
+					touched_stops.push_back(false);
+				}
+				result.new_stop_ids[stop.id] = static_cast<uint32_t>(result.catalogue.GetStopsCount());
+				result.catalogue.AddStop(std::move(new_stop));
+			}
+			for (const auto& change : changes.stops) {
+				if (result.catalogue.FindStop(change.name) == nullptr) {
+					result.catalogue.AddStop({ change.name, changed.at(change.name)->coordinates });
+					touched_stops.push_back(true);
+				}
+			}
+
+			//the first distance set for a pair wins, so the newest changes go first and the base follows
+			for (auto it = changes.stops.rbegin(); it != changes.stops.rend(); ++it) {
+				trans_ctl::Stop* from = result.catalogue.FindStop(it->name);
+				for (const auto& [name, distance] : it->road_distances) {
+					result.catalogue.SetStopsLength(from, FindStop(result.catalogue, name, "road_distances of "s + it->name), distance);
+				}
+			}
+			base.ForEachStopsLength([&result](uint32_t from_id, uint32_t to_id, double distance) {
+				const uint32_t from = result.new_stop_ids[from_id];
+				const uint32_t to = result.new_stop_ids[to_id];
+				if (from != NO_PREVIOUS && to != NO_PREVIOUS) {
+					result.catalogue.SetStopsLength(GetStop(result.catalogue, from), GetStop(result.catalogue, to), distance);
+				}
+			});
+		}
+
+		void AddBuses(const trans_ctl::TransportCatalogue& base, const Changes& changes, const std::vector<bool>& touched_stops, Rebuild& result) {
+			std::vector<bool> removed(base.GetBuses().size(), false);
+			for (const auto& name : changes.removed_buses) {
+				const trans_ctl::Bus* bus = base.FindBus(name);
+				if (bus == nullptr) {
+					throw std::runtime_error("Unknown bus "s + name + " in removed buses"s);
+				}
+				removed[bus->id] = true;
+			}
+
+			const auto changed = IndexByName(changes.buses);
+			auto make_bus = [&result](const BusChange& change) {
+				trans_ctl::Bus bus;
+				bus.name = change.name;
+				bus.isCircleRoute = change.is_roundtrip;
+				bus.stops.reserve(change.stops.size());
+				for (const auto& name : change.stops) {
+					bus.stops.push_back(FindStop(result.catalogue, name, "bus "s + change.name));
+				}
+				return bus;
+			};
+
+			for (const auto& previous : base.GetBuses()) {
+				if (removed[previous.id]) {
+					continue;
+				}
+				if (const auto it = changed.find(previous.name); it != changed.end()) {
+					result.catalogue.AddBus(make_bus(*it->second));
+					result.previous_bus_ids.push_back(NO_PREVIOUS);
+					continue;
+				}
+
+				trans_ctl::Bus bus{ previous.name, {}, previous.isCircleRoute, previous.stat };
+				bool touched = false;
+				bus.stops.reserve(previous.stops.size());
+				for (const auto* stop : previous.stops) {
+					const uint32_t id = result.new_stop_ids[stop->id];
+					if (id == NO_PREVIOUS) {
+						throw std::runtime_error("Removed stop "s + stop->name + " is still used by bus "s + previous.name);
+					}
+					touched = touched || touched_stops[id];
+					bus.stops.push_back(GetStop(result.catalogue, id));
+				}
+				result.catalogue.AddBus(std::move(bus));
+				result.previous_bus_ids.push_back(touched ? NO_PREVIOUS : previous.id);
+			}
+			for (const auto& change : changes.buses) {
+				if (result.catalogue.FindBus(change.name) == nullptr) {
+					result.catalogue.AddBus(make_bus(*changed.at(change.name)));
+					result.previous_bus_ids.push_back(NO_PREVIOUS);
+				}
+			}
+		}
+
+		Rebuild ApplyChanges(const trans_ctl::TransportCatalogue& base, const Changes& changes) {
+			Rebuild result;
+			std::vector<bool> touched_stops;
+			AddStops(base, changes, result, touched_stops);
+			AddBuses(base, changes, touched_stops, result);
+
+			//only the touched buses are recalculated, the others keep the stats from the base
+			for (uint32_t id = 0; id < result.previous_bus_ids.size(); ++id) {
+				auto* bus = const_cast<trans_ctl::Bus*>(&result.catalogue.GetBusById(id));
+				if (result.previous_bus_ids[id] == NO_PREVIOUS && !bus->stops.empty()) {
+					result.catalogue.CalcBusStat(bus);
+				}
+			}
+
+			result.catalogue.BuildStopBuses();
+			result.catalogue.BuildSpatialIndex();
+			result.catalogue.BuildNameIndexes();
+			return result;
+		}
+	}
+
+	DeltaStats WriteDelta(serialize::FlatDeserializer& base, const Changes& changes, bool compress, std::ostream& output) {
+		trans_ctl::TransportCatalogue base_catalogue = base.DeserializeTransportCatalogue();
+		Rebuild rebuild = ApplyChanges(base_catalogue, changes);
+
+		//the previous router is loaded without its shortest paths table, only its edges are needed
+		const graph::DirectedWeightedGraph<double> base_graph = base.DeserializeGraph();
+		const transport_router::TRouter base_router = base.DeserializeRouter(base_catalogue);
+		transport_router::TRouter router(base.DeserializeRouterSettings(), rebuild.catalogue);
+		router.BuildGraph(base_graph, base_router, rebuild.new_stop_ids, rebuild.previous_bus_ids);
+
+		//settings cannot change in a delta, so their parts are left out
+		serialize::FlatSerializer serializer(rebuild.catalogue, compress);
+		serializer.SetDeltaBase(base);
+		serializer.SerializeTransportCatalogue();
+		serializer.SerializeGraph(router.GetGraph());
+		serializer.SerializeRouter(router);
+		serializer.SaveTo(output);
+
+		DeltaStats stats;
+		stats.buses_count = rebuild.previous_bus_ids.size();
+		for (uint32_t previous_id : rebuild.previous_bus_ids) {
+			stats.rebuilt_buses += previous_id == NO_PREVIOUS ? 1 : 0;
+		}
+		return stats;
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "geo.h"
+
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace serialize {
+	class FlatDeserializer;
+}
+
+namespace delta {
+
+	// Остановка из delta_requests. Если в базе есть остановка с тем же именем, меняются её
+	// координаты, а road_distances дополняют и переопределяют её прежние расстояния
+	struct StopChange {
+		std::string name;
+		geo::Coordinates coordinates;
+		std::vector<std::pair<std::string, double>> road_distances;
+	};
+
+	// Маршрут из delta_requests, заменяет маршрут базы с тем же именем целиком
+	struct BusChange {
+		std::string name;
+		std::vector<std::string> stops;
+		bool is_roundtrip = false;
+	};
+
+	// Изменения каталога для make_delta. Остановки и маршруты базы сохраняют свой порядок,
+	// новые добавляются в конец, поэтому патч совпадает с базой, собранной make_base
+	// из тех же данных в том же порядке
+	struct Changes {
+		std::vector<StopChange> stops;
+		std::vector<BusChange> buses;
+		std::vector<std::string> removed_stops;
+		std::vector<std::string> removed_buses;
+	};
+
+	// Что пересобрал make_delta
+	struct DeltaStats {
+		size_t buses_count = 0;
+		size_t rebuilt_buses = 0;
+	};
+
+	// Пишет патч к плоской базе base. Статистика и рёбра графа считаются заново только для
+	// затронутых маршрутов: изменённых, новых и проходящих через изменённые остановки;
+	// остальные берутся из базы. В патч попадают секции, которые отличаются от секций base.
+	// С compress секции патча кодируются, как в сжатой базе.
+	// Бросает std::runtime_error, если изменения ссылаются на неизвестные имена или
+	// удалённая остановка остаётся на маршруте
+	DeltaStats WriteDelta(serialize::FlatDeserializer& base, const Changes& changes, bool compress, std::ostream& output);
+}
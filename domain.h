@@ -2,6 +2,7 @@
 
 #include "geo.h"
 #include "svg.h"
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <set>
@@ -14,6 +15,7 @@ namespace trans_ctl {
 	struct Stop {
 		std::string name;
 		geo::Coordinates coordinates;
+		uint32_t id = 0;
 	};
 
 	struct Segment {
@@ -34,6 +36,7 @@ namespace trans_ctl {
 		std::vector<Stop*> stops;
 		bool isCircleRoute = false;
 		BusStat stat;
+		uint32_t id = 0;
 	};
 
 	struct BusCmp {
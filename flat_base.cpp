@@ -0,0 +1,856 @@
+#include "flat_base.h"
+#include "checksum.h"
+#include "compression.h"
+#include "serialization.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+using namespace std::literals;
+
+namespace serialize {
+
+	namespace flat {
+		bool IsFlatBase(std::string_view data) {
+			return data.size() >= sizeof(MAGIC) && std::memcmp(data.data(), MAGIC, sizeof(MAGIC)) == 0;
+		}
+	}
+
+	namespace {
+		uint64_t AlignUp(uint64_t offset) {
+			return (offset + flat::ALIGNMENT - 1) / flat::ALIGNMENT * flat::ALIGNMENT;
+		}
+
+		// Таблица строк: смещения count + 1 имён и сами имена подряд
+		template <typename Objects>
+		std::pair<std::vector<uint32_t>, std::string> MakeNameTable(const Objects& objects) {
+			std::vector<uint32_t> offsets;
+			offsets.reserve(objects.size() + 1);
+			std::string names;
+			offsets.push_back(0);
+			for (const auto& object : objects) {
+				names += object.name;
+				offsets.push_back(static_cast<uint32_t>(names.size()));
+			}
+			return { std::move(offsets), std::move(names) };
+		}
+
+		template <typename T>
+		std::vector<T> ToArray(std::string_view bytes) {
+			std::vector<T> values(bytes.size() / sizeof(T));
+			std::memcpy(values.data(), bytes.data(), values.size() * sizeof(T));
+			return values;
+		}
+
+		template <typename T>
+		std::string ToBytes(const std::vector<T>& values) {
+			return std::string(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+		}
+
+		template <typename T>
+		size_t Size(ranges::Range<const T*> values) {
+			return values.end() - values.begin();
+		}
+
+		// Смещения строк CSR: count + 1 неубывающих значений от 0 до size
+		void CheckOffsets(ranges::Range<const uint32_t*> offsets, size_t count, size_t size) {
+			const uint32_t* data = offsets.begin();
+			if (Size(offsets) != count + 1 || data[0] != 0 || data[count] != size) {
+				throw std::runtime_error("Deserialization Error!");
+			}
+			for (size_t i = 0; i < count; ++i) {
+				if (data[i] > data[i + 1]) {
+					throw std::runtime_error("Deserialization Error!");
+				}
+			}
+		}
+
+		void CheckIds(ranges::Range<const uint32_t*> ids, size_t count) {
+			for (uint32_t id : ids) {
+				if (id >= count) {
+					throw std::runtime_error("Deserialization Error!");
+				}
+			}
+		}
+
+		// Порядок остановок для разностного кодирования координат: по первому появлению на маршрутах,
+		// соседние остановки маршрута близки и на карте, затем остальные по возрастанию id
+		std::vector<uint32_t> MakeRouteOrder(size_t stops_count, const std::vector<uint32_t>& route_stops) {
+			std::vector<uint32_t> order;
+			order.reserve(stops_count);
+			std::vector<bool> visited(stops_count, false);
+			for (uint32_t id : route_stops) {
+				if (id >= stops_count) {
+					throw std::runtime_error("Deserialization Error!");
+				}
+				if (!visited[id]) {
+					visited[id] = true;
+					order.push_back(id);
+				}
+			}
+			for (uint32_t id = 0; id < stops_count; ++id) {
+				if (!visited[id]) {
+					order.push_back(id);
+				}
+			}
+			return order;
+		}
+
+		std::vector<uint32_t> MakeRouteOrder(const trans_ctl::TransportCatalogue& catalogue) {
+			std::vector<uint32_t> route_stops;
+			for (const auto& bus : catalogue.GetBuses()) {
+				for (const auto* stop : bus.stops) {
+					route_stops.push_back(stop->id);
+				}
+			}
+			return MakeRouteOrder(catalogue.GetStopsCount(), route_stops);
+		}
+
+		std::string EncodeDeltaVarint(std::string_view bytes) {
+			std::string out;
+			int64_t previous = 0;
+			for (uint32_t value : ToArray<uint32_t>(bytes)) {
+				compression::WriteVarint(out, compression::ZigZag(static_cast<int64_t>(value) - previous));
+				previous = value;
+			}
+			return out;
+		}
+
+		std::string DecodeDeltaVarint(std::string_view payload) {
+			std::vector<uint32_t> values;
+			int64_t value = 0;
+			for (size_t pos = 0; pos < payload.size();) {
+				value += compression::UnZigZag(compression::ReadVarint(payload, pos));
+				if (value < 0 || value > UINT32_MAX) {
+					throw std::runtime_error("Deserialization Error!");
+				}
+				values.push_back(static_cast<uint32_t>(value));
+			}
+			return ToBytes(values);
+		}
+
+		// Пусто, если какую-то координату не восстановить из фиксированной точки точно
+		std::optional<std::string> EncodeCoordinates(std::string_view bytes, const std::vector<uint32_t>& order) {
+			const auto values = ToArray<double>(bytes);
+			if (values.size() != order.size()) {
+				return std::nullopt;
+			}
+
+			std::string out;
+			compression::WriteVarint(out, values.size());
+			int64_t previous = 0;
+			for (uint32_t id : order) {
+				const double value = values[id];
+				if (!(std::abs(value) <= 180.0)) {
+					return std::nullopt;
+				}
+				//division by the exact scale is correctly rounded, so decimal input with up to 7 digits survives
+				const int64_t fixed = std::llround(value * flat::COORDINATE_SCALE);
+				const double restored = static_cast<double>(fixed) / flat::COORDINATE_SCALE;
+				if (restored != value || std::signbit(restored) != std::signbit(value)) {
+					return std::nullopt;
+				}
+				compression::WriteVarint(out, compression::ZigZag(fixed - previous));
+				previous = fixed;
+			}
+			return out;
+		}
+
+		std::string DecodeCoordinates(std::string_view payload, const std::vector<uint32_t>& order) {
+			size_t pos = 0;
+			if (compression::ReadVarint(payload, pos) != order.size()) {
+				throw std::runtime_error("Deserialization Error!");
+			}
+			std::vector<double> values(order.size());
+			int64_t fixed = 0;
+			for (uint32_t id : order) {
+				fixed += compression::UnZigZag(compression::ReadVarint(payload, pos));
+				values[id] = static_cast<double>(fixed) / flat::COORDINATE_SCALE;
+			}
+			if (pos != payload.size()) {
+				throw std::runtime_error("Deserialization Error!");
+			}
+			return ToBytes(values);
+		}
+
+		// Веса идут отдельным столбцом после вершин: одинаковые веса ожидания лежат подряд и хорошо сжимаются
+		std::string EncodeEdges(std::string_view bytes) {
+			const auto edges = ToArray<flat::Edge>(bytes);
+			std::string out;
+			compression::WriteVarint(out, edges.size());
+			int64_t previous_from = 0;
+			for (const auto& edge : edges) {
+				compression::WriteVarint(out, compression::ZigZag(static_cast<int64_t>(edge.from) - previous_from));
+				compression::WriteVarint(out, compression::ZigZag(static_cast<int64_t>(edge.to) - static_cast<int64_t>(edge.from)));
+				previous_from = edge.from;
+			}
+			for (const auto& edge : edges) {
+				out.append(reinterpret_cast<const char*>(&edge.weight), sizeof(edge.weight));
+			}
+			return out;
+		}
+
+		std::string DecodeEdges(std::string_view payload) {
+			size_t pos = 0;
+			const uint64_t count = compression::ReadVarint(payload, pos);
+			if (count > payload.size()) {
+				throw std::runtime_error("Deserialization Error!");
+			}
+			std::vector<flat::Edge> edges(count);
+			int64_t from = 0;
+			for (auto& edge : edges) {
+				from += compression::UnZigZag(compression::ReadVarint(payload, pos));
+				const int64_t to = from + compression::UnZigZag(compression::ReadVarint(payload, pos));
+				if (from < 0 || from > UINT32_MAX || to < 0 || to > UINT32_MAX) {
+					throw std::runtime_error("Deserialization Error!");
+				}
+				edge.from = static_cast<uint32_t>(from);
+				edge.to = static_cast<uint32_t>(to);
+			}
+			if (payload.size() - pos != count * sizeof(double)) {
+				throw std::runtime_error("Deserialization Error!");
+			}
+			for (auto& edge : edges) {
+				std::memcpy(&edge.weight, payload.data() + pos, sizeof(edge.weight));
+				pos += sizeof(edge.weight);
+			}
+			return ToBytes(edges);
+		}
+	}
+
+	/*--------------------------------------------------------------------- SERIALIZE ----------------------------------------------------------------------*/
+
+	template <typename T>
+	void FlatSerializer::AddSection(Sections& part, flat::Section id, const std::vector<T>& values) {
+		AddSection(part, id, std::string_view(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T)));
+	}
+
+	void FlatSerializer::AddSection(Sections& part, flat::Section id, std::string_view bytes) {
+		if (delta_base_ != nullptr && delta_base_->FindSection(id) == bytes) {
+			return;
+		}
+		//checksums are taken in the task that prepared the part
+		EncodedSection section = EncodeSection(id, bytes);
+		section.crc = checksum::Crc32c(section.bytes);
+		section.hash = checksum::Hash64(section.bytes);
+		part.push_back(std::move(section));
+	}
+
+	FlatSerializer::EncodedSection FlatSerializer::EncodeSection(flat::Section id, std::string_view bytes) const {
+		if (!compress_) {
+			return { id, static_cast<uint32_t>(flat::Encoding::RAW), std::string(bytes) };
+		}
+
+		flat::Encoding encoding = flat::Encoding::RAW;
+		std::string encoded;
+		switch (id) {
+		case flat::Section::STOP_LATITUDES:
+		case flat::Section::STOP_LONGITUDES:
+			if (auto coordinates = EncodeCoordinates(bytes, MakeRouteOrder(catalogue_))) {
+				encoding = flat::Encoding::COORDINATES;
+				encoded = std::move(*coordinates);
+			}
+			else {
+				encoded = bytes;
+			}
+			break;
+		case flat::Section::STOP_NAME_OFFSETS:
+		case flat::Section::STOP_NAMES:
+		case flat::Section::BUS_NAME_OFFSETS:
+		case flat::Section::BUS_NAMES:
+			encoding = flat::Encoding::NAME_TABLE;
+			break;
+		case flat::Section::GRAPH_EDGES:
+			encoding = flat::Encoding::EDGES;
+			encoded = EncodeEdges(bytes);
+			break;
+		case flat::Section::BUS_STOP_OFFSETS:
+		case flat::Section::BUS_STOP_IDS:
+		case flat::Section::STOP_BUS_OFFSETS:
+		case flat::Section::STOP_BUS_IDS:
+		case flat::Section::DISTANCE_OFFSETS:
+		case flat::Section::DISTANCE_STOP_IDS:
+		case flat::Section::SPATIAL_INDEX:
+		case flat::Section::GRAPH_INCIDENCE_OFFSETS:
+		case flat::Section::GRAPH_INCIDENCE_EDGES:
+		case flat::Section::EDGE_BUS_IDS:
+		case flat::Section::EDGE_STOP_IDS:
+		case flat::Section::EDGE_SPAN_COUNTS:
+		case flat::Section::STOP_VERTICES:
+		case flat::Section::WAITING_VERTICES:
+			encoding = flat::Encoding::DELTA_VARINT;
+			encoded = EncodeDeltaVarint(bytes);
+			break;
+		default:
+			encoded = bytes;
+			break;
+		}
+
+		//block compression is kept only where it pays off
+		uint32_t flags = static_cast<uint32_t>(encoding);
+		if (!encoded.empty()) {
+			std::string compressed = compression::Compress(encoded);
+			if (compressed.size() < encoded.size()) {
+				encoded = std::move(compressed);
+				flags |= flat::BLOCK_COMPRESSED;
+			}
+		}
+		return { id, flags, std::move(encoded) };
+	}
+
+	FlatSerializer::Sections& FlatSerializer::GetPart(BasePart id) {
+		return parts_[static_cast<size_t>(id)];
+	}
+
+	void FlatSerializer::SerializeStops() {
+		Sections& part = GetPart(BasePart::STOPS);
+		const auto& stops = catalogue_.GetStops();
+
+		std::vector<double> latitudes;
+		std::vector<double> longitudes;
+		latitudes.reserve(stops.size());
+		longitudes.reserve(stops.size());
+		for (const auto& stop : stops) {
+			latitudes.push_back(stop.coordinates.lat);
+			longitudes.push_back(stop.coordinates.lng);
+		}
+		AddSection(part, flat::Section::STOP_LATITUDES, latitudes);
+		AddSection(part, flat::Section::STOP_LONGITUDES, longitudes);
+
+		const auto [name_offsets, names] = MakeNameTable(stops);
+		AddSection(part, flat::Section::STOP_NAME_OFFSETS, name_offsets);
+		AddSection(part, flat::Section::STOP_NAMES, names);
+
+		//buses passing through the stops, already sorted by name
+		std::vector<uint32_t> bus_offsets(1, 0);
+		std::vector<uint32_t> bus_ids;
+		for (const auto& stop : stops) {
+			const auto buses = catalogue_.GetStopBuses(stop.id);
+			bus_ids.insert(bus_ids.end(), buses.begin(), buses.end());
+			bus_offsets.push_back(static_cast<uint32_t>(bus_ids.size()));
+		}
+		AddSection(part, flat::Section::STOP_BUS_OFFSETS, bus_offsets);
+		AddSection(part, flat::Section::STOP_BUS_IDS, bus_ids);
+
+		const auto& order = catalogue_.GetSpatialIndex().GetOrder();
+		AddSection(part, flat::Section::SPATIAL_INDEX, order);
+		AddSection(part, flat::Section::STOP_NAME_INDEX, catalogue_.GetStopsNameIndex().GetData());
+	}
+
+	void FlatSerializer::SerializeStopDistances() {
+		Sections& part = GetPart(BasePart::STOP_DISTANCES);
+		//(from id, to id) pairs sorted, so every row of the CSR is sorted by neighbour id
+		std::vector<std::pair<std::pair<uint32_t, uint32_t>, double>> distances;
+		distances.reserve(catalogue_.GetAllStopLengths().size());
+		for (const auto& [stops, distance] : catalogue_.GetAllStopLengths()) {
+			distances.push_back({ { stops.first->id, stops.second->id }, distance });
+		}
+		std::sort(distances.begin(), distances.end());
+
+		std::vector<uint32_t> offsets(catalogue_.GetStopsCount() + 1, 0);
+		std::vector<uint32_t> stop_ids;
+		std::vector<double> values;
+		stop_ids.reserve(distances.size());
+		values.reserve(distances.size());
+		for (const auto& [stops, distance] : distances) {
+			++offsets[stops.first + 1];
+			stop_ids.push_back(stops.second);
+			values.push_back(distance);
+		}
+		for (size_t i = 1; i < offsets.size(); ++i) {
+			offsets[i] += offsets[i - 1];
+		}
+		AddSection(part, flat::Section::DISTANCE_OFFSETS, offsets);
+		AddSection(part, flat::Section::DISTANCE_STOP_IDS, stop_ids);
+		AddSection(part, flat::Section::DISTANCES, values);
+	}
+
+	void FlatSerializer::SerializeBusses() {
+		Sections& part = GetPart(BasePart::BUSES);
+		const auto& buses = catalogue_.GetBuses();
+
+		const auto [name_offsets, names] = MakeNameTable(buses);
+		AddSection(part, flat::Section::BUS_NAME_OFFSETS, name_offsets);
+		AddSection(part, flat::Section::BUS_NAMES, names);
+
+		std::vector<flat::BusInfo> infos;
+		std::vector<uint32_t> stop_offsets(1, 0);
+		std::vector<uint32_t> stop_ids;
+		infos.reserve(buses.size());
+		for (const auto& bus : buses) {
+			flat::BusInfo info{};
+			info.is_circle_route = bus.isCircleRoute ? 1 : 0;
+			info.stops_count = static_cast<uint32_t>(bus.stat.stops_count);
+			info.unique_stops_count = static_cast<uint32_t>(bus.stat.unique_stops_count);
+			info.route_distance = bus.stat.route_distance;
+			info.route_length = bus.stat.route_length;
+			infos.push_back(info);
+
+			for (const auto& stop : bus.stops) {
+				stop_ids.push_back(stop->id);
+			}
+			stop_offsets.push_back(static_cast<uint32_t>(stop_ids.size()));
+		}
+		AddSection(part, flat::Section::BUSES, infos);
+		AddSection(part, flat::Section::BUS_STOP_OFFSETS, stop_offsets);
+		AddSection(part, flat::Section::BUS_STOP_IDS, stop_ids);
+		AddSection(part, flat::Section::BUS_NAME_INDEX, catalogue_.GetBusesNameIndex().GetData());
+	}
+
+	void FlatSerializer::SerializeTransportCatalogue() {
+		SerializeStops();
+		SerializeStopDistances();
+		SerializeBusses();
+	}
+
+	void FlatSerializer::SerializeRenderSettings(const JsonReader& json_reader, const json::Document& document) {
+		Sections& part = GetPart(BasePart::RENDER_SETTINGS);
+		AddSection(part, flat::Section::RENDER_SETTINGS, RenderSettingsToMessage(json_reader.ParseRenderSettings(document)).SerializeAsString());
+	}
+
+	void FlatSerializer::SerializeRouterSettings(const JsonReader& json_reader, const json::Document& document) {
+		Sections& part = GetPart(BasePart::ROUTING_SETTINGS);
+		const transport_router::Routing_settings routing_settings = json_reader.ParseRoutingSettings(document);
+
+		flat::RoutingSettings settings{};
+		settings.bus_velocity = routing_settings.bus_velocity;
+		settings.bus_wait_time = routing_settings.bus_wait_time;
+		AddSection(part, flat::Section::ROUTING_SETTINGS, std::vector<flat::RoutingSettings>{ settings });
+	}
+
+	void FlatSerializer::SerializeGraph(const graph::DirectedWeightedGraph<double>& graph) {
+		Sections& part = GetPart(BasePart::GRAPH);
+		const size_t edge_count = graph.GetEdgeCount();
+		std::vector<flat::Edge> edges;
+		edges.reserve(edge_count);
+		for (size_t i = 0; i < edge_count; ++i) {
+			const auto& edge = graph.GetEdge(i);
+			edges.push_back({ static_cast<uint32_t>(edge.from), static_cast<uint32_t>(edge.to), edge.weight });
+		}
+		AddSection(part, flat::Section::GRAPH_EDGES, edges);
+
+		const size_t vertex_count = graph.GetVertexCount();
+		std::vector<uint32_t> offsets(1, 0);
+		std::vector<uint32_t> edge_ids;
+		offsets.reserve(vertex_count + 1);
+		edge_ids.reserve(edge_count);
+		for (size_t i = 0; i < vertex_count; ++i) {
+			for (const auto edge_id : graph.GetIncidentEdges(i)) {
+				edge_ids.push_back(static_cast<uint32_t>(edge_id));
+			}
+			offsets.push_back(static_cast<uint32_t>(edge_ids.size()));
+		}
+		AddSection(part, flat::Section::GRAPH_INCIDENCE_OFFSETS, offsets);
+		AddSection(part, flat::Section::GRAPH_INCIDENCE_EDGES, edge_ids);
+	}
+
+	void FlatSerializer::SerializeRouter(const transport_router::TRouter& router) {
+		Sections& part = GetPart(BasePart::ROUTER);
+		//vertices of every stop, indexed by stop id
+		const std::vector<uint32_t> stop_vertices(router.GetStopsIds().begin(), router.GetStopsIds().end());
+		const std::vector<uint32_t> waiting_vertices(router.GetWaitingStopsIds().begin(), router.GetWaitingStopsIds().end());
+		AddSection(part, flat::Section::STOP_VERTICES, stop_vertices);
+		AddSection(part, flat::Section::WAITING_VERTICES, waiting_vertices);
+
+		//edge metadata as parallel arrays indexed by edge id
+		//the wait kind is stored as NO_BUS in the bus id
+		const auto& edges_info = router.GetEdgesInfo();
+		std::vector<uint32_t> bus_ids(edges_info.bus_ids);
+		for (size_t id = 0; id < edges_info.Size(); ++id) {
+			if (edges_info.kinds[id] == transport_router::EdgeKind::WAIT) {
+				bus_ids[id] = flat::NO_BUS;
+			}
+		}
+		AddSection(part, flat::Section::EDGE_BUS_IDS, bus_ids);
+		AddSection(part, flat::Section::EDGE_STOP_IDS, edges_info.stop_ids);
+		AddSection(part, flat::Section::EDGE_SPAN_COUNTS, edges_info.span_counts);
+	}
+
+	void FlatSerializer::WriteHeader(std::ostream& output) {
+		flat::Header header = MakeBaseHeader(delta_base_ ? flat::DELTA_MAGIC : flat::MAGIC, flat::VERSION, static_cast<uint32_t>(directory_.size()));
+		header.content_hash = delta_base_ ? delta_base_->GetContentHash() : content_hash_;
+		header.header_crc = ComputeHeaderCrc(header,
+			{ reinterpret_cast<const char*>(directory_.data()), directory_.size() * sizeof(flat::SectionEntry) });
+
+		//the directory has room for every section, unused entries stay zero
+		std::vector<flat::SectionEntry> directory(directory_);
+		directory.resize(static_cast<size_t>(flat::Section::COUNT) - 1);
+		output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		output.write(reinterpret_cast<const char*>(directory.data()), directory.size() * sizeof(flat::SectionEntry));
+	}
+
+	void FlatSerializer::WritePart(BasePart id, std::ostream& output) {
+		if (position_ == 0) {
+			//the directory is not known yet, FinishWrite fills it in
+			WriteHeader(output);
+			position_ = sizeof(flat::Header) + (static_cast<size_t>(flat::Section::COUNT) - 1) * sizeof(flat::SectionEntry);
+		}
+
+		//each section starts on an aligned offset
+		static const char PADDING[flat::ALIGNMENT] = {};
+		Sections& part = GetPart(id);
+		for (const auto& section : part) {
+			const uint64_t offset = AlignUp(position_);
+			output.write(PADDING, offset - position_);
+			output.write(section.bytes.data(), section.bytes.size());
+			directory_.push_back({ section.id, section.encoding, offset, section.bytes.size(), section.crc, 0 });
+			position_ = offset + section.bytes.size();
+
+			const uint64_t summary[] = { static_cast<uint64_t>(section.id), section.encoding, section.bytes.size(), section.hash };
+			content_hash_ = checksum::Hash64({ reinterpret_cast<const char*>(summary), sizeof(summary) }, content_hash_);
+		}
+		Sections().swap(part);
+	}
+
+	void FlatSerializer::FinishWrite(std::ostream& output) {
+		if (position_ == 0) {
+			WriteHeader(output);
+		}
+		else {
+			output.seekp(0);
+			WriteHeader(output);
+			output.seekp(0, std::ios::end);
+		}
+		output.flush();
+	}
+
+	void FlatSerializer::SaveTo(std::ostream& output) {
+		for (size_t id = 0; id < parts_.size(); ++id) {
+			WritePart(static_cast<BasePart>(id), output);
+		}
+		FinishWrite(output);
+	}
+
+	void FlatSerializer::SetDeltaBase(const FlatDeserializer& base) {
+		delta_base_ = &base;
+	}
+
+	/*--------------------------------------------------------------------- DESERIALIZE ----------------------------------------------------------------------*/
+
+	FlatDeserializer::FlatDeserializer(std::string_view data) {
+		const flat::Header header = ReadBaseHeader(data, flat::MAGIC, flat::VERSION, sizeof(flat::SectionEntry));
+		content_hash_ = header.content_hash;
+		stored_.resize(static_cast<size_t>(flat::Section::COUNT));
+		sections_.resize(static_cast<size_t>(flat::Section::COUNT));
+		ReadSections(data, header);
+	}
+
+	FlatDeserializer::FlatDeserializer(std::string_view data, std::string_view delta)
+		: FlatDeserializer(data) {
+		if (delta.size() < sizeof(flat::DELTA_MAGIC) || std::memcmp(delta.data(), flat::DELTA_MAGIC, sizeof(flat::DELTA_MAGIC)) != 0) {
+			throw std::runtime_error("Unknown delta file format, rebuild the delta with make_delta");
+		}
+		const flat::Header header = ReadBaseHeader(delta, flat::DELTA_MAGIC, flat::VERSION, sizeof(flat::SectionEntry));
+		if (header.content_hash != content_hash_) {
+			throw std::runtime_error("Delta file was made for another base, rebuild the delta with make_delta");
+		}
+
+		//coordinates and name tables are decoded with other sections of their own file,
+		//so they are decoded before the delta replaces those
+		for (size_t index = 0; index < stored_.size(); ++index) {
+			const auto encoding = static_cast<flat::Encoding>(stored_[index].encoding & ~flat::BLOCK_COMPRESSED);
+			if (stored_[index].present && (encoding == flat::Encoding::COORDINATES || encoding == flat::Encoding::NAME_TABLE)) {
+				GetSection(static_cast<flat::Section>(index));
+			}
+		}
+		ReadSections(delta, header);
+	}
+
+	void FlatDeserializer::ReadSections(std::string_view data, const flat::Header& header) {
+		for (uint32_t i = 0; i < header.section_count; ++i) {
+			flat::SectionEntry entry;
+			std::memcpy(&entry, data.data() + sizeof(header) + i * sizeof(entry), sizeof(entry));
+			if (entry.offset > data.size() || entry.size > data.size() - entry.offset) {
+				throw std::runtime_error("Base file is truncated");
+			}
+			//a bad base is refused before any section is read
+			if (checksum::Crc32c(data.substr(entry.offset, entry.size)) != entry.crc) {
+				throw std::runtime_error("Base file checksum mismatch");
+			}
+			//sections unknown to this version are skipped
+			const auto index = static_cast<size_t>(entry.id);
+			if (index < sections_.size()) {
+				stored_[index] = { true, entry.encoding, data.substr(entry.offset, entry.size) };
+				sections_[index] = std::nullopt;
+				if (entry.encoding == static_cast<uint32_t>(flat::Encoding::RAW)) {
+					sections_[index] = stored_[index].bytes;
+				}
+			}
+		}
+	}
+
+	std::string_view FlatDeserializer::GetSection(flat::Section id) const {
+		const auto index = static_cast<size_t>(id);
+		if (!stored_[index].present) {
+			throw std::runtime_error("Deserialization Error!");
+		}
+		if (!sections_[index]) {
+			sections_[index] = DecodeSection(id);
+		}
+		return *sections_[index];
+	}
+
+	std::optional<std::string_view> FlatDeserializer::FindSection(flat::Section id) const {
+		const auto index = static_cast<size_t>(id);
+		if (index >= stored_.size() || !stored_[index].present) {
+			return std::nullopt;
+		}
+		return GetSection(id);
+	}
+
+	std::string_view FlatDeserializer::StoreBuffer(std::string_view bytes) const {
+		//buffers from new[] are aligned for any section type
+		auto& buffer = buffers_.emplace_back(new char[bytes.size()]);
+		std::memcpy(buffer.get(), bytes.data(), bytes.size());
+		return { buffer.get(), bytes.size() };
+	}
+
+	std::string_view FlatDeserializer::DecodeSection(flat::Section id) const {
+		const StoredSection& stored = stored_[static_cast<size_t>(id)];
+		std::string_view payload = stored.bytes;
+		std::string decompressed;
+		if (stored.encoding & flat::BLOCK_COMPRESSED) {
+			decompressed = compression::Decompress(payload);
+			payload = decompressed;
+		}
+
+		switch (static_cast<flat::Encoding>(stored.encoding & ~flat::BLOCK_COMPRESSED)) {
+		case flat::Encoding::RAW:
+			return StoreBuffer(payload);
+		case flat::Encoding::DELTA_VARINT:
+			return StoreBuffer(DecodeDeltaVarint(payload));
+		case flat::Encoding::COORDINATES: {
+			size_t pos = 0;
+			const auto stops_count = static_cast<size_t>(compression::ReadVarint(payload, pos));
+			const auto route_stops = GetArray<uint32_t>(flat::Section::BUS_STOP_IDS);
+			const auto order = MakeRouteOrder(stops_count, { route_stops.begin(), route_stops.end() });
+			return StoreBuffer(DecodeCoordinates(payload, order));
+		}
+		case flat::Encoding::EDGES:
+			return StoreBuffer(DecodeEdges(payload));
+		case flat::Encoding::NAME_TABLE:
+			if (id == flat::Section::STOP_NAME_OFFSETS || id == flat::Section::STOP_NAMES) {
+				DecodeNameTable(flat::Section::STOP_NAME_OFFSETS, flat::Section::STOP_NAMES, flat::Section::STOP_NAME_INDEX);
+			}
+			else {
+				DecodeNameTable(flat::Section::BUS_NAME_OFFSETS, flat::Section::BUS_NAMES, flat::Section::BUS_NAME_INDEX);
+			}
+			if (!sections_[static_cast<size_t>(id)]) {
+				throw std::runtime_error("Deserialization Error!");
+			}
+			return *sections_[static_cast<size_t>(id)];
+		}
+		throw std::runtime_error("Unsupported section encoding");
+	}
+
+	void FlatDeserializer::DecodeNameTable(flat::Section offsets_id, flat::Section names_id, flat::Section index_id) const {
+		trans_ctl::NameIndex index;
+		index.View(GetSection(index_id));
+		const uint32_t count = index.GetCount();
+		std::vector<std::string> names(count);
+		std::vector<bool> seen(count, false);
+		index.ForEach([&names, &seen, count](std::string_view name, uint32_t id) {
+			if (id >= count || seen[id]) {
+				throw std::runtime_error("Deserialization Error!");
+			}
+			seen[id] = true;
+			names[id] = name;
+		});
+
+		std::vector<uint32_t> offsets;
+		std::string table;
+		offsets.reserve(count + 1);
+		offsets.push_back(0);
+		for (const auto& name : names) {
+			table += name;
+			offsets.push_back(static_cast<uint32_t>(table.size()));
+		}
+		sections_[static_cast<size_t>(offsets_id)] = StoreBuffer(ToBytes(offsets));
+		sections_[static_cast<size_t>(names_id)] = StoreBuffer(table);
+	}
+
+	template <typename T>
+	ranges::Range<const T*> FlatDeserializer::GetArray(flat::Section id) const {
+		const std::string_view section = GetSection(id);
+		if (section.size() % sizeof(T) != 0 || reinterpret_cast<uintptr_t>(section.data()) % alignof(T) != 0) {
+			throw std::runtime_error("Deserialization Error!");
+		}
+		const T* data = reinterpret_cast<const T*>(section.data());
+		return { data, data + section.size() / sizeof(T) };
+	}
+
+	trans_ctl::TransportCatalogue FlatDeserializer::DeserializeTransportCatalogue() {
+		trans_ctl::TransportCatalogue catalogue;
+		//lookups by name go through the stored indexes, read in place
+		catalogue.ViewNameIndexes(GetSection(flat::Section::STOP_NAME_INDEX), GetSection(flat::Section::BUS_NAME_INDEX));
+
+		const auto latitudes = GetArray<double>(flat::Section::STOP_LATITUDES);
+		const auto longitudes = GetArray<double>(flat::Section::STOP_LONGITUDES).begin();
+		const auto stop_name_offsets = GetArray<uint32_t>(flat::Section::STOP_NAME_OFFSETS);
+		const std::string_view stop_names = GetSection(flat::Section::STOP_NAMES);
+		const auto infos = GetArray<flat::BusInfo>(flat::Section::BUSES);
+		const auto bus_name_offsets = GetArray<uint32_t>(flat::Section::BUS_NAME_OFFSETS);
+		const std::string_view bus_names = GetSection(flat::Section::BUS_NAMES);
+		const auto bus_stop_offsets = GetArray<uint32_t>(flat::Section::BUS_STOP_OFFSETS);
+		const auto bus_stop_ids = GetArray<uint32_t>(flat::Section::BUS_STOP_IDS);
+		const auto stop_bus_offsets = GetArray<uint32_t>(flat::Section::STOP_BUS_OFFSETS);
+		const auto stop_bus_ids = GetArray<uint32_t>(flat::Section::STOP_BUS_IDS);
+		const auto distance_offsets = GetArray<uint32_t>(flat::Section::DISTANCE_OFFSETS);
+		const auto distance_stop_ids = GetArray<uint32_t>(flat::Section::DISTANCE_STOP_IDS);
+		const auto distances = GetArray<double>(flat::Section::DISTANCES);
+
+		//sizes and ids are checked once here, afterwards the sections are indexed without checks
+		const size_t stops_count = Size(latitudes);
+		const size_t buses_count = Size(infos);
+		if (Size(GetArray<double>(flat::Section::STOP_LONGITUDES)) != stops_count
+			|| Size(distances) != Size(distance_stop_ids)) {
+			throw std::runtime_error("Deserialization Error!");
+		}
+		CheckOffsets(stop_name_offsets, stops_count, stop_names.size());
+		CheckOffsets(bus_name_offsets, buses_count, bus_names.size());
+		CheckOffsets(bus_stop_offsets, buses_count, Size(bus_stop_ids));
+		CheckOffsets(stop_bus_offsets, stops_count, Size(stop_bus_ids));
+		CheckOffsets(distance_offsets, stops_count, Size(distance_stop_ids));
+		CheckIds(bus_stop_ids, stops_count);
+		CheckIds(stop_bus_ids, buses_count);
+		CheckIds(distance_stop_ids, stops_count);
+
+		for (size_t i = 0; i < stops_count; ++i) {
+			trans_ctl::Stop stop;
+			const uint32_t name_begin = stop_name_offsets.begin()[i];
+			stop.name = stop_names.substr(name_begin, stop_name_offsets.begin()[i + 1] - name_begin);
+			stop.coordinates = { latitudes.begin()[i], longitudes[i] };
+			catalogue.AddStop(std::move(stop));
+		}
+
+		for (size_t i = 0; i < buses_count; ++i) {
+			const flat::BusInfo& info = infos.begin()[i];
+			const uint32_t* name_offsets = bus_name_offsets.begin();
+			const uint32_t* stop_offsets = bus_stop_offsets.begin();
+			trans_ctl::Bus bus;
+			bus.name = bus_names.substr(name_offsets[i], name_offsets[i + 1] - name_offsets[i]);
+
+			//stops are resolved by id, the deque keeps their addresses stable
+			bus.stops.reserve(stop_offsets[i + 1] - stop_offsets[i]);
+			for (uint32_t j = stop_offsets[i]; j < stop_offsets[i + 1]; ++j) {
+				bus.stops.push_back(const_cast<trans_ctl::Stop*>(&catalogue.GetStopById(bus_stop_ids.begin()[j])));
+			}
+
+			bus.isCircleRoute = info.is_circle_route != 0;
+			bus.stat.stops_count = info.stops_count;
+			bus.stat.unique_stops_count = info.unique_stops_count;
+			bus.stat.route_distance = info.route_distance;
+			bus.stat.route_length = info.route_length;
+			catalogue.AddBus(std::move(bus));
+		}
+
+		catalogue.ViewStopBuses(stop_bus_offsets, stop_bus_ids);
+		catalogue.ViewStopsLengths(distance_offsets, distance_stop_ids, distances);
+
+		const auto order = GetArray<uint32_t>(flat::Section::SPATIAL_INDEX);
+		catalogue.SetSpatialIndex({ order.begin(), order.end() });
+
+		return catalogue;
+	}
+
+	render::RenderSettings FlatDeserializer::DeserializeRenderSettings() {
+		const std::string_view section = GetSection(flat::Section::RENDER_SETTINGS);
+		render_settings_serialize::RenderSettings message;
+		if (!message.ParseFromArray(section.data(), static_cast<int>(section.size()))) {
+			throw std::runtime_error("Deserialization Error!");
+		}
+		return RenderSettingsFromMessage(message);
+	}
+
+	transport_router::Routing_settings FlatDeserializer::DeserializeRouterSettings() {
+		const auto settings = GetArray<flat::RoutingSettings>(flat::Section::ROUTING_SETTINGS);
+		if (settings.begin() == settings.end()) {
+			throw std::runtime_error("Deserialization Error!");
+		}
+
+		transport_router::Routing_settings routing_settings_;
+		routing_settings_.bus_wait_time = settings.begin()->bus_wait_time;
+		routing_settings_.bus_velocity = settings.begin()->bus_velocity;
+		return routing_settings_;
+	}
+
+	size_t FlatDeserializer::GetVertexCount() const {
+		const auto offsets = GetArray<uint32_t>(flat::Section::GRAPH_INCIDENCE_OFFSETS);
+		if (offsets.begin() == offsets.end()) {
+			throw std::runtime_error("Deserialization Error!");
+		}
+		return Size(offsets) - 1;
+	}
+
+	graph::DirectedWeightedGraph<double> FlatDeserializer::DeserializeGraph() {
+		const auto edges = GetArray<flat::Edge>(flat::Section::GRAPH_EDGES);
+		const auto offsets = GetArray<uint32_t>(flat::Section::GRAPH_INCIDENCE_OFFSETS);
+		const auto edge_ids = GetArray<uint32_t>(flat::Section::GRAPH_INCIDENCE_EDGES);
+		const size_t vertex_count = GetVertexCount();
+		CheckOffsets(offsets, vertex_count, Size(edge_ids));
+		CheckIds(edge_ids, Size(edges));
+
+		std::vector<graph::Edge<double>> edges_;
+		edges_.reserve(Size(edges));
+		for (const auto& edge : edges) {
+			if (edge.from >= vertex_count || edge.to >= vertex_count) {
+				throw std::runtime_error("Deserialization Error!");
+			}
+			edges_.push_back({ edge.from, edge.to, edge.weight });
+		}
+
+		//incidence lists are copied row by row with their exact sizes
+		std::vector<std::vector<graph::EdgeId>> incidence_lists(vertex_count);
+		for (size_t i = 0; i < vertex_count; ++i) {
+			incidence_lists[i].assign(edge_ids.begin() + offsets.begin()[i], edge_ids.begin() + offsets.begin()[i + 1]);
+		}
+
+		return graph::DirectedWeightedGraph<double>(std::move(edges_), std::move(incidence_lists));
+	}
+
+	transport_router::TRouter FlatDeserializer::DeserializeRouter(trans_ctl::TransportCatalogue& catalogue) {
+		const auto stop_vertices = GetArray<uint32_t>(flat::Section::STOP_VERTICES);
+		const auto waiting_vertices = GetArray<uint32_t>(flat::Section::WAITING_VERTICES);
+		if (Size(stop_vertices) != catalogue.GetStopsCount() || Size(waiting_vertices) != catalogue.GetStopsCount()) {
+			throw std::runtime_error("Deserialization Error!");
+		}
+		CheckIds(stop_vertices, GetVertexCount());
+		CheckIds(waiting_vertices, GetVertexCount());
+		std::vector<size_t> stops_ids_(stop_vertices.begin(), stop_vertices.end());
+		std::vector<size_t> waiting_stops_ids_(waiting_vertices.begin(), waiting_vertices.end());
+
+		const auto bus_ids = GetArray<uint32_t>(flat::Section::EDGE_BUS_IDS);
+		const auto stop_ids = GetArray<uint32_t>(flat::Section::EDGE_STOP_IDS);
+		const auto span_counts = GetArray<uint32_t>(flat::Section::EDGE_SPAN_COUNTS);
+		const size_t edge_count = Size(bus_ids);
+		if (Size(stop_ids) != edge_count
+			|| Size(span_counts) != edge_count
+			|| Size(GetArray<flat::Edge>(flat::Section::GRAPH_EDGES)) != edge_count) {
+			throw std::runtime_error("Deserialization Error!");
+		}
+
+		transport_router::EdgesInfo edges_info_;
+		edges_info_.kinds.reserve(edge_count);
+		edges_info_.bus_ids.reserve(edge_count);
+		for (uint32_t bus_id : bus_ids) {
+			const bool is_wait = bus_id == flat::NO_BUS;
+			if (!is_wait && bus_id >= catalogue.GetBuses().size()) {
+				throw std::runtime_error("Deserialization Error!");
+			}
+			edges_info_.kinds.push_back(is_wait ? transport_router::EdgeKind::WAIT : transport_router::EdgeKind::BUS);
+			edges_info_.bus_ids.push_back(is_wait ? 0 : bus_id);
+		}
+		CheckIds(stop_ids, catalogue.GetStopsCount());
+		edges_info_.stop_ids.assign(stop_ids.begin(), stop_ids.end());
+		edges_info_.span_counts.assign(span_counts.begin(), span_counts.end());
+
+		return transport_router::TRouter(DeserializeRouterSettings(),
+			catalogue,
+			std::move(waiting_stops_ids_),
+			std::move(stops_ids_),
+			std::move(edges_info_));
+	}
+}
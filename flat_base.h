@@ -0,0 +1,237 @@
+#pragma once
+
+#include "domain.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+#include "json_reader.h"
+#include "ranges.h"
+#include "serialization.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace serialize {
+
+	// Плоский формат базы: заголовок BaseHeader, каталог секций и сами секции, выровненные по 8 байт.
+	// Каждая секция - массив значений одного типа фиксированного размера в порядке байт
+	// little-endian. Ссылки между секциями - индексы, а не указатели, поэтому process_requests
+	// отображает файл в память и читает массивы на месте, ничего не разбирая.
+	// В сжатой базе секции закодированы (см. Encoding) и распаковываются при первом обращении,
+	// каждая независимо от других.
+	// Формат protobuf остаётся для обмена базами с другими программами: после заголовка
+	// и каталога частей в нём лежит обычное сообщение TransportCatalogue
+	namespace flat {
+		inline constexpr char MAGIC[8] = { 'T', 'C', 'F', 'L', 'A', 'T', '\0', '\0' };
+		// Патч к плоской базе от make_delta: тот же заголовок и каталог, но в нём только секции,
+		// которые отличаются от базы, а content_hash - хеш базы, к которой патч применяется
+		inline constexpr char DELTA_MAGIC[8] = { 'T', 'C', 'D', 'E', 'L', 'T', 'A', '\0' };
+		// Версия 2 добавила кодирование секций, версия 3 - контрольные суммы.
+		// Базы прежних версий не читаются, их нужно собрать заново
+		inline constexpr uint32_t VERSION = 3;
+		inline constexpr uint64_t ALIGNMENT = 8;
+		// id маршрута у ребра ожидания на остановке
+		inline constexpr uint32_t NO_BUS = UINT32_MAX;
+
+		enum class Section : uint32_t {
+			STOP_LATITUDES = 1,      // double[stops]
+			STOP_LONGITUDES,         // double[stops]
+			STOP_NAME_OFFSETS,       // uint32[stops + 1], имя остановки i - STOP_NAMES[offsets[i]..offsets[i + 1])
+			STOP_NAMES,              // char[]
+			BUS_NAME_OFFSETS,        // uint32[buses + 1]
+			BUS_NAMES,               // char[]
+			BUSES,                   // BusInfo[buses]
+			BUS_STOP_OFFSETS,        // uint32[buses + 1], остановки маршрута i - BUS_STOP_IDS[offsets[i]..offsets[i + 1])
+			BUS_STOP_IDS,            // uint32[]
+			STOP_BUS_OFFSETS,        // uint32[stops + 1], маршруты через остановку в порядке имён
+			STOP_BUS_IDS,            // uint32[]
+			DISTANCE_OFFSETS,        // uint32[stops + 1], расстояния от остановки, соседи по возрастанию id
+			DISTANCE_STOP_IDS,       // uint32[]
+			DISTANCES,               // double[]
+			SPATIAL_INDEX,           // uint32[stops], порядок id в k-d дереве
+			STOP_NAME_INDEX,         // char[], блок trans_ctl::NameIndex
+			BUS_NAME_INDEX,          // char[]
+			RENDER_SETTINGS,         // char[], сообщение render_settings_serialize.RenderSettings
+			ROUTING_SETTINGS,        // RoutingSettings[1]
+			GRAPH_EDGES,             // Edge[edges]
+			GRAPH_INCIDENCE_OFFSETS, // uint32[vertices + 1], рёбра из вершины v - GRAPH_INCIDENCE_EDGES[offsets[v]..offsets[v + 1])
+			GRAPH_INCIDENCE_EDGES,   // uint32[edges]
+			EDGE_BUS_IDS,            // uint32[edges], NO_BUS для ожидания на остановке
+			EDGE_STOP_IDS,           // uint32[edges], остановка, с которой начинается ребро
+			EDGE_SPAN_COUNTS,        // uint32[edges]
+			STOP_VERTICES,           // uint32[stops], вершина остановки в графе
+			WAITING_VERTICES,        // uint32[stops], вершина ожидания на остановке
+			COUNT,
+		};
+
+		// Преобразование данных секции в сжатой базе
+		enum class Encoding : uint32_t {
+			RAW = 0,
+			// uint32[]: разности соседних значений, zigzag varint
+			DELTA_VARINT = 1,
+			// double[] координат: число значений varint, затем фиксированная точка с шагом
+			// 1 / COORDINATE_SCALE градуса, разности вдоль маршрутов zigzag varint.
+			// Применяется, только если все координаты восстанавливаются без потерь
+			COORDINATES = 2,
+			// Edge[]: число рёбер varint, для каждого разность from с предыдущим ребром и разность
+			// to с from zigzag varint, затем веса всех рёбер как есть
+			EDGES = 3,
+			// Таблица имён без данных: восстанавливается из индекса имён, где имена уже сжаты фронтально
+			NAME_TABLE = 4,
+		};
+
+		// Флаг в SectionEntry::encoding: после преобразования секция сжата блоками, см. compression.h
+		inline constexpr uint32_t BLOCK_COMPRESSED = 0x100;
+		inline constexpr double COORDINATE_SCALE = 1e7;
+
+		using Header = BaseHeader;
+
+		// Смещение секции отсчитывается от начала файла, size - размер данных в файле,
+		// crc - CRC32C этих данных
+		struct SectionEntry {
+			Section id;
+			// Encoding, возможно с флагом BLOCK_COMPRESSED
+			uint32_t encoding;
+			uint64_t offset;
+			uint64_t size;
+			uint32_t crc;
+			uint32_t reserved;
+		};
+
+		struct BusInfo {
+			uint32_t is_circle_route;
+			uint32_t stops_count;
+			uint32_t unique_stops_count;
+			uint32_t reserved;
+			double route_distance;
+			double route_length;
+		};
+
+		struct RoutingSettings {
+			double bus_velocity;
+			int32_t bus_wait_time;
+			uint32_t reserved;
+		};
+
+		struct Edge {
+			uint32_t from;
+			uint32_t to;
+			double weight;
+		};
+
+		static_assert(sizeof(SectionEntry) == 32);
+		static_assert(sizeof(BusInfo) == 32 && sizeof(RoutingSettings) == 16 && sizeof(Edge) == 16);
+
+		// Начинаются ли данные с заголовка плоской базы
+		bool IsFlatBase(std::string_view data);
+	}
+
+	class FlatDeserializer;
+
+	// Собирает плоскую базу, интерфейс повторяет Serializer.
+	// Секции пишутся в файл по мере готовности частей, каталог секций в начале файла
+	// заполняется в FinishWrite, поэтому поток вывода должен поддерживать seekp.
+	// С compress секции кодируются и сжимаются блоками: файл меньше, но читается не на месте
+	class FlatSerializer {
+	public:
+		explicit FlatSerializer(const trans_ctl::TransportCatalogue& catalogue, bool compress = false)
+			: catalogue_(catalogue), compress_(compress) {}
+		void SerializeTransportCatalogue();
+		void SerializeStops();
+		void SerializeStopDistances();
+		void SerializeBusses();
+		void SerializeRenderSettings(const JsonReader& json_reader, const json::Document& document);
+		void SerializeRouterSettings(const JsonReader& json_reader, const json::Document& document);
+		void SerializeGraph(const graph::DirectedWeightedGraph<double>& graph);
+		void SerializeRouter(const transport_router::TRouter& router);
+		void WritePart(BasePart id, std::ostream& output);
+		void FinishWrite(std::ostream& output);
+		void SaveTo(std::ostream& output);
+		// Дальше собирается патч к base: секции, которые совпадают с секциями base после распаковки,
+		// не кодируются и не пишутся, как и части, которые не сериализовались. base должна жить
+		// до конца записи
+		void SetDeltaBase(const FlatDeserializer& base);
+
+	private:
+		struct EncodedSection {
+			flat::Section id;
+			uint32_t encoding;
+			std::string bytes;
+			uint32_t crc = 0;
+			uint64_t hash = 0;
+		};
+		using Sections = std::vector<EncodedSection>;
+
+		const trans_ctl::TransportCatalogue& catalogue_;
+		bool compress_ = false;
+		std::vector<Sections> parts_ = std::vector<Sections>(static_cast<size_t>(BasePart::COUNT));
+		std::vector<flat::SectionEntry> directory_;
+		uint64_t position_ = 0;
+		uint64_t content_hash_ = 0;
+		// База, к которой пишется патч
+		const FlatDeserializer* delta_base_ = nullptr;
+
+		Sections& GetPart(BasePart id);
+		template <typename T>
+		void AddSection(Sections& part, flat::Section id, const std::vector<T>& values);
+		void AddSection(Sections& part, flat::Section id, std::string_view bytes);
+		EncodedSection EncodeSection(flat::Section id, std::string_view bytes) const;
+		void WriteHeader(std::ostream& output);
+	};
+
+	// Читает плоскую базу на месте, интерфейс повторяет Deserializer.
+	// Индексы имён, списки маршрутов остановок и расстояния каталог использует прямо из data,
+	// остановки, маршруты, граф и вершины маршрутизатора восстанавливаются по id, без поиска по имени
+	class FlatDeserializer {
+	public:
+		// data должна жить дольше каталога, а для сжатой базы и сам десериализатор: распакованные
+		// секции хранятся в нём. Бросает std::runtime_error, если это не плоская база
+		// подходящей версии, каталог секций выходит за пределы данных или не сходится
+		// контрольная сумма заголовка или какой-либо секции. Суммы проверяются здесь,
+		// до разбора: база читается, только если цела целиком
+		explicit FlatDeserializer(std::string_view data);
+		// База с патчем от make_delta: секции патча заменяют одноимённые секции базы.
+		// delta тоже должна жить дольше каталога. Бросает std::runtime_error ещё и тогда,
+		// когда патч собран для другой базы
+		FlatDeserializer(std::string_view data, std::string_view delta);
+		// Размеры секций и id в них проверяются при загрузке: Deserialize* бросают
+		// std::runtime_error, если смещения выходят за секции или id - за число объектов
+		trans_ctl::TransportCatalogue DeserializeTransportCatalogue();
+		render::RenderSettings DeserializeRenderSettings();
+		transport_router::Routing_settings DeserializeRouterSettings();
+		graph::DirectedWeightedGraph<double> DeserializeGraph();
+		transport_router::TRouter DeserializeRouter(trans_ctl::TransportCatalogue& catalogue);
+		uint64_t GetContentHash() const { return content_hash_; }
+		// Распакованные данные секции или nullopt, если её нет в базе
+		std::optional<std::string_view> FindSection(flat::Section id) const;
+
+	private:
+		struct StoredSection {
+			bool present = false;
+			uint32_t encoding = 0;
+			std::string_view bytes;
+		};
+
+		uint64_t content_hash_ = 0;
+		std::vector<StoredSection> stored_;
+		// Секции, готовые к чтению: сырые указывают в data, закодированные - в buffers_
+		mutable std::vector<std::optional<std::string_view>> sections_;
+		mutable std::vector<std::unique_ptr<char[]>> buffers_;
+
+		void ReadSections(std::string_view data, const flat::Header& header);
+		// Распаковывает секцию при первом обращении
+		std::string_view GetSection(flat::Section id) const;
+		std::string_view DecodeSection(flat::Section id) const;
+		void DecodeNameTable(flat::Section offsets_id, flat::Section names_id, flat::Section index_id) const;
+		std::string_view StoreBuffer(std::string_view bytes) const;
+		template <typename T>
+		ranges::Range<const T*> GetArray(flat::Section id) const;
+		// Число вершин графа по секции смещений списков инцидентности
+		size_t GetVertexCount() const;
+	};
+}
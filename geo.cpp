@@ -1 +1,20 @@
 #include "geo.h"
+
+namespace geo {
+
+    void ComputeDistances(const double* from_x, const double* from_y, const double* from_z,
+                          const double* to_x, const double* to_y, const double* to_z,
+                          double* __restrict result, size_t count) {
+        //first pass is pure arithmetic without branches, so it is vectorized by the compiler
+        for (size_t i = 0; i < count; ++i) {
+            const double dx = from_x[i] - to_x[i];
+            const double dy = from_y[i] - to_y[i];
+            const double dz = from_z[i] - to_z[i];
+            result[i] = dx * dx + dy * dy + dz * dz;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            result[i] = ChordToDistance(result[i]);
+        }
+    }
+
+}
@@ -1,10 +1,14 @@
 #pragma once
 
 #include <cmath>
+#include <cstddef>
+#include <vector>
 
 namespace geo {
 
     inline const int EARTH_RADIUS = 6371000;
+    inline const double PI = 3.14159265358979323846;
+    inline const double DEG_TO_RAD = PI / 180.0;
 
     struct Coordinates {
         double lat;
@@ -17,14 +21,73 @@ namespace geo {
         }
     };
 
+    // Точка на единичной сфере: (cos(lat) * cos(lng), cos(lat) * sin(lng), sin(lat)).
+    // Синусы и косинусы считаются один раз, дальше расстояние - только арифметика и один asin.
+    struct SpherePoint {
+        double x;
+        double y;
+        double z;
+    };
+
+    inline SpherePoint ToSpherePoint(Coordinates coordinates) {
+        const double lat = coordinates.lat * DEG_TO_RAD;
+        const double lng = coordinates.lng * DEG_TO_RAD;
+        const double cos_lat = std::cos(lat);
+        return { cos_lat * std::cos(lng), cos_lat * std::sin(lng), std::sin(lat) };
+    }
+
+    // Расстояние по дуге через длину хорды: формула гаверсинусов, hav = chord^2 / 4
+    inline double ChordToDistance(double chord_squared) {
+        const double half_chord = std::sqrt(chord_squared) / 2.0;
+        return 2.0 * EARTH_RADIUS * std::asin(half_chord < 1.0 ? half_chord : 1.0);
+    }
+
+    inline double ComputeDistance(SpherePoint from, SpherePoint to) {
+        const double dx = from.x - to.x;
+        const double dy = from.y - to.y;
+        const double dz = from.z - to.z;
+        return ChordToDistance(dx * dx + dy * dy + dz * dz);
+    }
+
+    // Скалярный вариант для одиночных пар координат
     inline double ComputeDistance(Coordinates from, Coordinates to) {
-        using namespace std;
         if (from == to) {
             return 0.0;
         }
-        static const double dr = 3.1415926535 / 180.0;
-        return acos(sin(from.lat * dr) * sin(to.lat * dr)
-            + cos(from.lat * dr) * cos(to.lat * dr) * cos(abs(from.lng - to.lng) * dr))
-            * EARTH_RADIUS;
+        return ComputeDistance(ToSpherePoint(from), ToSpherePoint(to));
     }
-}
\ No newline at end of file
+
+    // Точки на единичной сфере в виде структуры массивов, индекс - id точки
+    struct SpherePoints {
+        std::vector<double> x;
+        std::vector<double> y;
+        std::vector<double> z;
+
+        void Add(Coordinates coordinates) {
+            const SpherePoint point = ToSpherePoint(coordinates);
+            x.push_back(point.x);
+            y.push_back(point.y);
+            z.push_back(point.z);
+        }
+
+        SpherePoint Get(size_t id) const {
+            return { x[id], y[id], z[id] };
+        }
+
+        size_t Size() const {
+            return x.size();
+        }
+
+        void Clear() {
+            x.clear();
+            y.clear();
+            z.clear();
+        }
+    };
+
+    // Пакетное вычисление result[i] = расстояние(from[i], to[i]) для count пар.
+    // Массивы from и to могут пересекаться (например, to = from + 1 для соседних остановок маршрута).
+    void ComputeDistances(const double* from_x, const double* from_y, const double* from_z,
+                          const double* to_x, const double* to_y, const double* to_z,
+                          double* result, size_t count);
+}
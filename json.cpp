@@ -1,156 +1,222 @@
 #include "json.h"
 
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <exception>
 #include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace json {
 
 namespace {
 using namespace std::literals;
 
-Node LoadNode(std::istream& input);
-Node LoadString(std::istream& input);
+// Размер порции, которой читается поток, если вход не передан целиком
+constexpr size_t CHUNK_SIZE = 1 << 16;
+// Массивы меньше этого размера разбираются в одном потоке: запуск потоков дороже разбора
+constexpr size_t PARALLEL_MIN_SIZE = 1 << 20;
+// Отрезков на поток: потоки, которым достались простые элементы, берут следующие отрезки
+constexpr size_t CHUNKS_PER_THREAD = 4;
 
-std::string LoadLiteral(std::istream& input) {
-    std::string s;
-    while (std::isalpha(input.peek())) {
-        s.push_back(static_cast<char>(input.get()));
-    }
-    return s;
+bool IsSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+bool IsDigit(char c) {
+    return c >= '0' && c <= '9';
 }
 
-Node LoadArray(std::istream& input) {
-    std::vector<Node> result;
+bool IsNumberChar(char c) {
+    return IsDigit(c) || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
 
-    for (char c; input >> c && c != ']';) {
-        if (c != ',') {
-            input.putback(c);
+bool IsAlpha(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+// Пропускает пробельные символы, возвращает указатель на первый непробельный или end
+const char* SkipSpaces(const char* cur, const char* end) {
+#ifdef __SSE2__
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i carriage = _mm_set1_epi8('\r');
+    const __m128i tab = _mm_set1_epi8('\t');
+    while (end - cur >= 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur));
+        const __m128i spaces = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, newline)),
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, carriage), _mm_cmpeq_epi8(chunk, tab)));
+        const unsigned mask = ~static_cast<unsigned>(_mm_movemask_epi8(spaces)) & 0xFFFFu;
+        if (mask != 0) {
+            return cur + __builtin_ctz(mask);
         }
-        result.push_back(LoadNode(input));
+        cur += 16;
     }
-    if (!input) {
-        throw ParsingError("Array parsing error"s);
+#endif
+    while (cur != end && IsSpace(*cur)) {
+        ++cur;
     }
-    return Node(std::move(result));
+    return cur;
 }
 
-Node LoadDict(std::istream& input) {
-    Dict dict;
-
-    for (char c; input >> c && c != '}';) {
-        if (c == '"') {
-            std::string key = LoadString(input).AsString();
-            if (input >> c && c == ':') {
-                if (dict.find(key) != dict.end()) {
-                    throw ParsingError("Duplicate key '"s + key + "' have been found");
-                }
-                dict.emplace(std::move(key), LoadNode(input));
-            } else {
-                throw ParsingError(": is expected but '"s + c + "' has been found"s);
-            }
-        } else if (c != ',') {
-            throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
+// Ищет первый символ строки, требующий обработки: кавычку, '\' или перевод строки
+const char* FindStringSpecial(const char* cur, const char* end) {
+#ifdef __SSE2__
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i carriage = _mm_set1_epi8('\r');
+    while (end - cur >= 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur));
+        const __m128i special = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, newline), _mm_cmpeq_epi8(chunk, carriage)));
+        const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(special));
+        if (mask != 0) {
+            return cur + __builtin_ctz(mask);
         }
+        cur += 16;
     }
-    if (!input) {
-        throw ParsingError("Dictionary parsing error"s);
+#endif
+    while (cur != end && *cur != '"' && *cur != '\\' && *cur != '\n' && *cur != '\r') {
+        ++cur;
     }
-    return Node(std::move(dict));
+    return cur;
 }
 
-Node LoadString(std::istream& input) {
-    auto it = std::istreambuf_iterator<char>(input);
-    auto end = std::istreambuf_iterator<char>();
-    std::string s;
-    while (true) {
-        if (it == end) {
-            throw ParsingError("String parsing error");
+// Ищет первый структурный символ: кавычку, скобку или запятую
+const char* FindStructural(const char* cur, const char* end) {
+#ifdef __SSE2__
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i open_array = _mm_set1_epi8('[');
+    const __m128i close_array = _mm_set1_epi8(']');
+    const __m128i open_dict = _mm_set1_epi8('{');
+    const __m128i close_dict = _mm_set1_epi8('}');
+    while (end - cur >= 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur));
+        const __m128i structural = _mm_or_si128(
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, comma)),
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, open_array), _mm_cmpeq_epi8(chunk, close_array))),
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, open_dict), _mm_cmpeq_epi8(chunk, close_dict)));
+        const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(structural));
+        if (mask != 0) {
+            return cur + __builtin_ctz(mask);
         }
-        const char ch = *it;
-        if (ch == '"') {
-            ++it;
-            break;
-        } else if (ch == '\\') {
-            ++it;
-            if (it == end) {
-                throw ParsingError("String parsing error");
-            }
-            const char escaped_char = *(it);
-            switch (escaped_char) {
-                case 'n':
-                    s.push_back('\n');
-                    break;
-                case 't':
-                    s.push_back('\t');
-                    break;
-                case 'r':
-                    s.push_back('\r');
-                    break;
-                case '"':
-                    s.push_back('"');
-                    break;
-                case '\\':
-                    s.push_back('\\');
-                    break;
-                default:
-                    throw ParsingError("Unrecognized escape sequence \\"s + escaped_char);
-            }
-        } else if (ch == '\n' || ch == '\r') {
-            throw ParsingError("Unexpected end of line"s);
-        } else {
-            s.push_back(ch);
-        }
-        ++it;
+        cur += 16;
     }
-
-    return Node(std::move(s));
+#endif
+    while (cur != end && *cur != '"' && *cur != ',' && *cur != '[' && *cur != ']' && *cur != '{' && *cur != '}') {
+        ++cur;
+    }
+    return cur;
 }
 
-Node LoadBool(std::istream& input) {
-    const auto s = LoadLiteral(input);
-    if (s == "true"sv) {
-        return Node{true};
-    } else if (s == "false"sv) {
-        return Node{false};
-    } else {
-        throw ParsingError("Failed to parse '"s + s + "' as bool"s);
+// Первый проход параллельного разбора: границы элементов массива, который начинается с '[' в begin.
+// Первая граница - сразу за '[', дальше запятые верхнего уровня, последняя - закрывающая ']'.
+// nullopt, если структура не сходится: такой вход разбирается последовательно, он и сообщит ошибку
+std::optional<std::vector<const char*>> FindArrayBoundaries(const char* begin, const char* end) {
+    std::vector<const char*> boundaries;
+    const char* cur = begin + 1;
+    boundaries.push_back(cur);
+    size_t depth = 0;
+    while (true) {
+        cur = FindStructural(cur, end);
+        if (cur == end) {
+            return std::nullopt;
+        }
+        switch (*cur) {
+            case '"':
+                //skip the string, an escaped character can be a quote
+                ++cur;
+                while (true) {
+                    cur = FindStringSpecial(cur, end);
+                    if (cur == end || *cur == '\n' || *cur == '\r') {
+                        return std::nullopt;
+                    }
+                    if (*cur == '"') {
+                        ++cur;
+                        break;
+                    }
+                    if (end - cur < 2) {
+                        return std::nullopt;
+                    }
+                    cur += 2;
+                }
+                break;
+            case '[':
+                [[fallthrough]];
+            case '{':
+                ++depth;
+                ++cur;
+                break;
+            case ',':
+                if (depth == 0) {
+                    boundaries.push_back(cur);
+                }
+                ++cur;
+                break;
+            default:
+                if (depth == 0) {
+                    if (*cur != ']') {
+                        return std::nullopt;
+                    }
+                    boundaries.push_back(cur);
+                    return boundaries;
+                }
+                --depth;
+                ++cur;
+                break;
+        }
     }
 }
 
-Node LoadNull(std::istream& input) {
-    if (auto literal = LoadLiteral(input); literal == "null"sv) {
-        return Node{nullptr};
-    } else {
-        throw ParsingError("Failed to parse '"s + literal + "' as null"s);
+// Символ, который обозначает escape-последовательность \\escaped_char
+char Unescape(char escaped_char) {
+    switch (escaped_char) {
+        case 'n':
+            return '\n';
+        case 't':
+            return '\t';
+        case 'r':
+            return '\r';
+        case '"':
+            return '"';
+        case '\\':
+            return '\\';
+        default:
+            throw ParsingError("Unrecognized escape sequence \\"s + escaped_char);
     }
 }
 
-Node LoadNumber(std::istream& input) {
-    std::string parsed_num;
+// Разбирает число в начале [cur, end) и сдвигает cur за него
+std::variant<int, double> ParseNumber(const char*& cur, const char* end) {
+    const char* pos = cur;
 
-    // Считывает в parsed_num очередной символ из input
-    auto read_char = [&parsed_num, &input] {
-        parsed_num += static_cast<char>(input.get());
-        if (!input) {
-            throw ParsingError("Failed to read number from stream"s);
-        }
-    };
-
-    // Считывает одну или более цифр в parsed_num из input
-    auto read_digits = [&input, read_char] {
-        if (!std::isdigit(input.peek())) {
+    // Считывает одну или более цифр
+    auto read_digits = [&pos, end] {
+        if (pos == end || !IsDigit(*pos)) {
             throw ParsingError("A digit is expected"s);
         }
-        while (std::isdigit(input.peek())) {
-            read_char();
+        while (pos != end && IsDigit(*pos)) {
+            ++pos;
         }
     };
 
-    if (input.peek() == '-') {
-        read_char();
+    if (pos != end && *pos == '-') {
+        ++pos;
     }
     // Парсим целую часть числа
-    if (input.peek() == '0') {
-        read_char();
+    if (pos != end && *pos == '0') {
+        ++pos;
         // После 0 в JSON не могут идти другие цифры
     } else {
         read_digits();
@@ -158,115 +224,708 @@ Node LoadNumber(std::istream& input) {
 
     bool is_int = true;
     // Парсим дробную часть числа
-    if (input.peek() == '.') {
-        read_char();
+    if (pos != end && *pos == '.') {
+        ++pos;
         read_digits();
         is_int = false;
     }
 
     // Парсим экспоненциальную часть числа
-    if (int ch = input.peek(); ch == 'e' || ch == 'E') {
-        read_char();
-        if (ch = input.peek(); ch == '+' || ch == '-') {
-            read_char();
+    if (pos != end && (*pos == 'e' || *pos == 'E')) {
+        ++pos;
+        if (pos != end && (*pos == '+' || *pos == '-')) {
+            ++pos;
         }
         read_digits();
         is_int = false;
     }
 
-    try {
-        if (is_int) {
-            // Сначала пробуем преобразовать строку в int
-            try {
-                return std::stoi(parsed_num);
-            } catch (...) {
-                // В случае неудачи, например, при переполнении
-                // код ниже попробует преобразовать строку в double
-            }
+    const char* begin = cur;
+    cur = pos;
+    if (is_int) {
+        // Сначала пробуем преобразовать строку в int, при переполнении - в double
+        int value;
+        if (auto [ptr, ec] = std::from_chars(begin, pos, value); ec == std::errc{} && ptr == pos) {
+            return value;
         }
-        return std::stod(parsed_num);
-    } catch (...) {
-        throw ParsingError("Failed to convert "s + parsed_num + " to number"s);
     }
+    double value;
+    if (auto [ptr, ec] = std::from_chars(begin, pos, value); ec == std::errc{} && ptr == pos) {
+        return value;
+    }
+    throw ParsingError("Failed to convert "s + std::string(begin, pos) + " to number"s);
 }
 
-Node LoadNode(std::istream& input) {
-    char c;
-    if (!(input >> c)) {
-        throw ParsingError("Unexpected EOF"s);
+}  // namespace
+
+// Разбирает JSON из непрерывного буфера. Если вход - поток, буфер дочитывается порциями:
+// непрочитанный хвост переносится в начало, и разбор продолжается по указателям.
+class Parser {
+public:
+    explicit Parser(std::string_view data)
+        : cur_(data.data())
+        , end_(data.data() + data.size()) {
     }
-    switch (c) {
-        case '[':
-            return LoadArray(input);
-        case '{':
-            return LoadDict(input);
-        case '"':
-            return LoadString(input);
-        case 't':
-            // Атрибут [[fallthrough]] (провалиться) ничего не делает, и является
-            // подсказкой компилятору и человеку, что здесь программист явно задумывал
-            // разрешить переход к инструкции следующей ветки case, а не случайно забыл
-            // написать break, return или throw.
-            // В данном случае, встретив t или f, переходим к попытке парсинга
-            // литералов true либо false
-            [[fallthrough]];
-        case 'f':
-            input.putback(c);
-            return LoadBool(input);
-        case 'n':
-            input.putback(c);
-            return LoadNull(input);
-        default:
-            input.putback(c);
-            return LoadNumber(input);
+
+    explicit Parser(std::istream& input)
+        : input_(&input)
+        , buffer_(CHUNK_SIZE) {
+        cur_ = end_ = buffer_.data();
+    }
+
+    Node LoadNode() {
+        if (!SkipWhitespace()) {
+            throw ParsingError("Unexpected EOF"s);
+        }
+        switch (*cur_) {
+            case '[':
+                ++cur_;
+                return LoadArray();
+            case '{':
+                ++cur_;
+                return LoadDict();
+            case '"':
+                ++cur_;
+                return Node(LoadString());
+            case 't':
+                [[fallthrough]];
+            case 'f':
+                return LoadBool();
+            case 'n':
+                return LoadNull();
+            default:
+                return LoadNumber();
+        }
+    }
+
+    void Begin(char open) {
+        if (!SkipWhitespace()) {
+            throw ParsingError("Unexpected EOF"s);
+        }
+        if (*cur_ != open) {
+            throw ParsingError("'"s + open + "' is expected but '"s + *cur_ + "' has been found"s);
+        }
+        ++cur_;
+    }
+
+    // Шаг цикла LoadArray: false на ']'
+    bool NextElement() {
+        char c;
+        if (!ReadChar(c)) {
+            throw ParsingError("Array parsing error"s);
+        }
+        if (c == ']') {
+            return false;
+        }
+        if (c != ',') {
+            --cur_;
+        }
+        return true;
+    }
+
+    bool IsContiguous() const {
+        return input_ == nullptr;
+    }
+
+    CompactDocument ReadCompact(size_t thread_count);
+
+    // Шаг цикла LoadDict: читает ключ и двоеточие, false на '}'
+    bool NextKey(std::string& key) {
+        char c;
+        while (true) {
+            if (!ReadChar(c)) {
+                throw ParsingError("Dictionary parsing error"s);
+            }
+            if (c == '}') {
+                return false;
+            }
+            if (c == '"') {
+                key = LoadString();
+                if (ReadChar(c) && c == ':') {
+                    return true;
+                }
+                throw ParsingError(": is expected but '"s + c + "' has been found"s);
+            }
+            if (c != ',') {
+                throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
+            }
+        }
+    }
+
+private:
+    const char* cur_ = nullptr;
+    const char* end_ = nullptr;
+    std::istream* input_ = nullptr;
+    std::vector<char> buffer_;
+
+    // Дочитывает поток в буфер, сохраняя непрочитанные байты. false, если данных больше нет
+    bool Refill() {
+        if (input_ == nullptr || !*input_) {
+            return false;
+        }
+        const size_t left = end_ - cur_;
+        if (left * 2 > buffer_.size()) {
+            std::vector<char> bigger(buffer_.size() * 2);
+            std::copy(cur_, end_, bigger.data());
+            buffer_.swap(bigger);
+        }
+        else {
+            std::copy(cur_, end_, buffer_.data());
+        }
+        char* data = buffer_.data();
+        input_->read(data + left, static_cast<std::streamsize>(buffer_.size() - left));
+        const auto read = static_cast<size_t>(input_->gcount());
+        cur_ = data;
+        end_ = data + left + read;
+        return read != 0;
+    }
+
+    // Гарантирует, что в буфере доступно не меньше count байт, если поток их содержит
+    bool EnsureAvailable(size_t count) {
+        while (static_cast<size_t>(end_ - cur_) < count) {
+            if (!Refill()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool SkipWhitespace() {
+        while (true) {
+            cur_ = SkipSpaces(cur_, end_);
+            if (cur_ != end_) {
+                return true;
+            }
+            if (!Refill()) {
+                return false;
+            }
+        }
+    }
+
+    // Аналог input >> c: пропускает пробелы и читает символ
+    bool ReadChar(char& c) {
+        if (!SkipWhitespace()) {
+            return false;
+        }
+        c = *cur_++;
+        return true;
+    }
+
+    std::string_view LoadLiteral() {
+        size_t size = 0;
+        while (true) {
+            while (cur_ + size != end_ && IsAlpha(cur_[size])) {
+                ++size;
+            }
+            if (cur_ + size != end_ || !EnsureAvailable(size + 1)) {
+                break;
+            }
+        }
+        std::string_view literal(cur_, size);
+        cur_ += size;
+        return literal;
+    }
+
+    Node LoadArray() {
+        std::vector<Node> result;
+
+        char c;
+        bool ok;
+        while ((ok = ReadChar(c)) && c != ']') {
+            if (c != ',') {
+                --cur_;
+            }
+            result.push_back(LoadNode());
+        }
+        if (!ok) {
+            throw ParsingError("Array parsing error"s);
+        }
+        return Node(std::move(result));
+    }
+
+    Node LoadDict() {
+        Dict dict;
+
+        char c;
+        bool ok;
+        while ((ok = ReadChar(c)) && c != '}') {
+            if (c == '"') {
+                std::string key = LoadString();
+                if (ReadChar(c) && c == ':') {
+                    if (dict.find(key) != dict.end()) {
+                        throw ParsingError("Duplicate key '"s + key + "' have been found");
+                    }
+                    Node value = LoadNode();
+                    dict.emplace(std::move(key), std::move(value));
+                } else {
+                    throw ParsingError(": is expected but '"s + c + "' has been found"s);
+                }
+            } else if (c != ',') {
+                throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
+            }
+        }
+        if (!ok) {
+            throw ParsingError("Dictionary parsing error"s);
+        }
+        return Node(std::move(dict));
+    }
+
+    std::string LoadString() {
+        std::string s;
+        while (true) {
+            const char* special = FindStringSpecial(cur_, end_);
+            s.append(cur_, special);
+            cur_ = special;
+            if (cur_ == end_) {
+                if (!Refill()) {
+                    throw ParsingError("String parsing error");
+                }
+                continue;
+            }
+            const char ch = *cur_++;
+            if (ch == '"') {
+                break;
+            }
+            if (ch == '\n' || ch == '\r') {
+                throw ParsingError("Unexpected end of line"s);
+            }
+            // ch == '\\'
+            if (cur_ == end_ && !Refill()) {
+                throw ParsingError("String parsing error");
+            }
+            s.push_back(Unescape(*cur_++));
+        }
+        return s;
+    }
+
+    Node LoadBool() {
+        const auto s = LoadLiteral();
+        if (s == "true"sv) {
+            return Node{true};
+        } else if (s == "false"sv) {
+            return Node{false};
+        } else {
+            throw ParsingError("Failed to parse '"s + std::string(s) + "' as bool"s);
+        }
+    }
+
+    Node LoadNull() {
+        if (auto literal = LoadLiteral(); literal == "null"sv) {
+            return Node{nullptr};
+        } else {
+            throw ParsingError("Failed to parse '"s + std::string(literal) + "' as null"s);
+        }
+    }
+
+    Node LoadNumber() {
+        // Число целиком должно лежать в буфере: дочитываем, пока не встретим его конец
+        size_t size = 0;
+        while (true) {
+            while (cur_ + size != end_ && IsNumberChar(cur_[size])) {
+                ++size;
+            }
+            if (cur_ + size != end_ || !EnsureAvailable(size + 1)) {
+                break;
+            }
+        }
+
+        return std::visit([](auto value) {
+            return Node(value);
+        }, ParseNumber(cur_, end_));
+    }
+};
+
+// Строит компактное дерево по буферу, целиком лежащему в памяти.
+// Элементы незакрытых массивов и словарей копятся на общих стеках и при закрытии
+// одним куском переносятся в арену, так что арена заполняется только готовыми узлами.
+class CompactParser {
+public:
+    CompactParser(std::string_view data, std::pmr::memory_resource& arena)
+        : cur_(data.data())
+        , end_(data.data() + data.size())
+        , arena_(arena) {
+    }
+
+    CompactNode LoadNode() {
+        cur_ = SkipSpaces(cur_, end_);
+        if (cur_ == end_) {
+            throw ParsingError("Unexpected EOF"s);
+        }
+        switch (*cur_) {
+            case '[':
+                ++cur_;
+                return LoadArray();
+            case '{':
+                ++cur_;
+                return LoadDict();
+            case '"':
+                ++cur_;
+                return CompactNode::MakeString(LoadString());
+            case 't':
+                [[fallthrough]];
+            case 'f':
+                return LoadBool();
+            case 'n':
+                return LoadNull();
+            default:
+                return std::visit([](auto value) {
+                    return MakeNumber(value);
+                }, ParseNumber(cur_, end_));
+        }
+    }
+
+    // Элементы одного отрезка массива при параллельном разборе. Отрезок начинается сразу за '['
+    // или с запятой верхнего уровня, и читается тем же циклом, что и в LoadArray
+    void LoadElements(std::vector<CompactNode>& elements) {
+        char c;
+        while (ReadChar(c)) {
+            if (c != ',') {
+                --cur_;
+            }
+            elements.push_back(LoadNode());
+        }
+    }
+
+    const char* GetPosition() const {
+        return cur_;
+    }
+
+private:
+    const char* cur_;
+    const char* end_;
+    std::pmr::memory_resource& arena_;
+    std::vector<CompactNode> items_;
+    std::vector<CompactMember> members_;
+    std::string unescaped_;
+
+    static CompactNode MakeNumber(int value) {
+        return CompactNode::MakeInt(value);
+    }
+    static CompactNode MakeNumber(double value) {
+        return CompactNode::MakeDouble(value);
+    }
+
+    bool ReadChar(char& c) {
+        cur_ = SkipSpaces(cur_, end_);
+        if (cur_ == end_) {
+            return false;
+        }
+        c = *cur_++;
+        return true;
+    }
+
+    // Переносит элементы [first, стек.end()) в арену и снимает их со стека
+    template <typename T>
+    const T* MoveToArena(std::vector<T>& stack, size_t first) {
+        const size_t count = stack.size() - first;
+        if (count == 0) {
+            return nullptr;
+        }
+        auto* data = static_cast<T*>(arena_.allocate(count * sizeof(T), alignof(T)));
+        std::uninitialized_copy(stack.begin() + first, stack.end(), data);
+        stack.resize(first);
+        return data;
+    }
+
+    CompactNode LoadArray() {
+        const size_t first = items_.size();
+
+        char c;
+        bool ok;
+        while ((ok = ReadChar(c)) && c != ']') {
+            if (c != ',') {
+                --cur_;
+            }
+            CompactNode item = LoadNode();
+            items_.push_back(item);
+        }
+        if (!ok) {
+            throw ParsingError("Array parsing error"s);
+        }
+        const auto size = static_cast<uint32_t>(items_.size() - first);
+        return CompactNode::MakeArray(MoveToArena(items_, first), size);
+    }
+
+    CompactNode LoadDict() {
+        const size_t first = members_.size();
+
+        char c;
+        bool ok;
+        while ((ok = ReadChar(c)) && c != '}') {
+            if (c == '"') {
+                const std::string_view key = LoadString();
+                if (ReadChar(c) && c == ':') {
+                    CompactNode value = LoadNode();
+                    members_.push_back({key, value});
+                } else {
+                    throw ParsingError(": is expected but '"s + c + "' has been found"s);
+                }
+            } else if (c != ',') {
+                throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
+            }
+        }
+        if (!ok) {
+            throw ParsingError("Dictionary parsing error"s);
+        }
+
+        const auto begin = members_.begin() + first;
+        std::stable_sort(begin, members_.end(), [](const CompactMember& lhs, const CompactMember& rhs) {
+            return lhs.key < rhs.key;
+        });
+        const auto duplicate = std::adjacent_find(begin, members_.end(), [](const CompactMember& lhs, const CompactMember& rhs) {
+            return lhs.key == rhs.key;
+        });
+        if (duplicate != members_.end()) {
+            throw ParsingError("Duplicate key '"s + std::string(duplicate->key) + "' have been found");
+        }
+        const auto size = static_cast<uint32_t>(members_.size() - first);
+        return CompactNode::MakeDict(MoveToArena(members_, first), size);
+    }
+
+    // Строка без escape-последовательностей возвращается видом на вход, иначе она
+    // раскодируется и копируется в арену
+    std::string_view LoadString() {
+        const char* begin = cur_;
+        const char* special = FindStringSpecial(cur_, end_);
+        if (special != end_ && *special == '"') {
+            cur_ = special + 1;
+            return {begin, static_cast<size_t>(special - begin)};
+        }
+
+        unescaped_.assign(begin, special);
+        cur_ = special;
+        while (true) {
+            if (cur_ == end_) {
+                throw ParsingError("String parsing error");
+            }
+            const char ch = *cur_++;
+            if (ch == '"') {
+                break;
+            }
+            if (ch == '\n' || ch == '\r') {
+                throw ParsingError("Unexpected end of line"s);
+            }
+            // ch == '\\'
+            if (cur_ == end_) {
+                throw ParsingError("String parsing error");
+            }
+            unescaped_.push_back(Unescape(*cur_++));
+            special = FindStringSpecial(cur_, end_);
+            unescaped_.append(cur_, special);
+            cur_ = special;
+        }
+        auto* data = static_cast<char*>(arena_.allocate(unescaped_.size(), alignof(char)));
+        std::copy(unescaped_.begin(), unescaped_.end(), data);
+        return {data, unescaped_.size()};
+    }
+
+    std::string_view LoadLiteral() {
+        const char* begin = cur_;
+        while (cur_ != end_ && IsAlpha(*cur_)) {
+            ++cur_;
+        }
+        return {begin, static_cast<size_t>(cur_ - begin)};
+    }
+
+    CompactNode LoadBool() {
+        const auto s = LoadLiteral();
+        if (s == "true"sv) {
+            return CompactNode::MakeBool(true);
+        } else if (s == "false"sv) {
+            return CompactNode::MakeBool(false);
+        } else {
+            throw ParsingError("Failed to parse '"s + std::string(s) + "' as bool"s);
+        }
+    }
+
+    CompactNode LoadNull() {
+        if (auto literal = LoadLiteral(); literal == "null"sv) {
+            return CompactNode{};
+        } else {
+            throw ParsingError("Failed to parse '"s + std::string(literal) + "' as null"s);
+        }
+    }
+};
+
+// Собирает CompactDocument: последовательно или, для большого массива, на нескольких потоках
+class CompactLoader {
+public:
+    // Разбирает значение в начале input, consumed - сколько байт входа прочитано
+    static CompactDocument Load(std::string_view input, size_t thread_count, size_t& consumed) {
+        const char* end = input.data() + input.size();
+        const char* begin = SkipSpaces(input.data(), end);
+        if (thread_count > 1 && begin != end && *begin == '[' && static_cast<size_t>(end - begin) >= PARALLEL_MIN_SIZE) {
+            if (auto document = LoadArrayParallel(begin, end, thread_count)) {
+                consumed = document->second - input.data();
+                return std::move(document->first);
+            }
+        }
+
+        CompactDocument document;
+        //the tree is usually smaller than the text, so the first block fits most documents
+        auto& arena = AddArena(document, input.size());
+        CompactParser parser(input, arena);
+        document.root_ = parser.LoadNode();
+        consumed = parser.GetPosition() - input.data();
+        return document;
+    }
+
+    // Разбирает текст, который документ забирает себе
+    static CompactDocument LoadOwned(const std::string& text) {
+        CompactDocument document;
+        auto& arena = AddArena(document, text.size() * 2);
+        auto* data = static_cast<char*>(arena.allocate(text.size(), alignof(char)));
+        std::copy(text.begin(), text.end(), data);
+        document.root_ = CompactParser({data, text.size()}, arena).LoadNode();
+        return document;
+    }
+
+private:
+    struct Chunk {
+        Chunk(const char* begin, const char* end)
+            : begin(begin), end(end) {
+        }
+
+        const char* begin;
+        const char* end;
+        std::unique_ptr<std::pmr::monotonic_buffer_resource> arena;
+        std::vector<CompactNode> elements;
+        bool failed = false;
+    };
+
+    static std::pmr::monotonic_buffer_resource& AddArena(CompactDocument& document, size_t initial_size) {
+        document.arenas_.push_back(std::make_unique<std::pmr::monotonic_buffer_resource>(std::max<size_t>(initial_size, 1024)));
+        return *document.arenas_.back();
+    }
+
+    // Документ и конец прочитанного массива, nullopt - массив надо разобрать последовательно
+    static std::optional<std::pair<CompactDocument, const char*>> LoadArrayParallel(const char* begin, const char* end, size_t thread_count) {
+        const auto boundaries = FindArrayBoundaries(begin, end);
+        if (!boundaries) {
+            return std::nullopt;
+        }
+
+        //cut at element boundaries into chunks of roughly equal size
+        std::vector<Chunk> chunks;
+        const char* close = boundaries->back();
+        const size_t chunk_size = std::max<size_t>((close - begin) / (thread_count * CHUNKS_PER_THREAD), 1);
+        const char* chunk_begin = boundaries->front();
+        for (size_t i = 1; i < boundaries->size(); ++i) {
+            const char* boundary = (*boundaries)[i];
+            if (boundary == close || static_cast<size_t>(boundary - chunk_begin) >= chunk_size) {
+                chunks.emplace_back(chunk_begin, boundary);
+                chunk_begin = boundary;
+            }
+        }
+
+        std::atomic<size_t> next_chunk = 0;
+        auto work = [&chunks, &next_chunk] {
+            for (size_t i = next_chunk++; i < chunks.size(); i = next_chunk++) {
+                Chunk& chunk = chunks[i];
+                const std::string_view text(chunk.begin, chunk.end - chunk.begin);
+                chunk.arena = std::make_unique<std::pmr::monotonic_buffer_resource>(std::max<size_t>(text.size(), 1024));
+                try {
+                    CompactParser(text, *chunk.arena).LoadElements(chunk.elements);
+                } catch (const std::exception&) {
+                    chunk.failed = true;
+                }
+            }
+        };
+        std::vector<std::thread> workers;
+        const size_t worker_count = std::min(thread_count, chunks.size());
+        for (size_t i = 1; i < worker_count; ++i) {
+            workers.emplace_back(work);
+        }
+        work();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        size_t count = 0;
+        for (const Chunk& chunk : chunks) {
+            if (chunk.failed) {
+                return std::nullopt;
+            }
+            count += chunk.elements.size();
+        }
+
+        //merge in input order, the chunk arenas move into the document
+        CompactDocument document;
+        auto& arena = AddArena(document, count * sizeof(CompactNode));
+        auto* elements = count == 0 ? nullptr : static_cast<CompactNode*>(arena.allocate(count * sizeof(CompactNode), alignof(CompactNode)));
+        CompactNode* out = elements;
+        for (Chunk& chunk : chunks) {
+            out = std::uninitialized_copy(chunk.elements.begin(), chunk.elements.end(), out);
+            document.arenas_.push_back(std::move(chunk.arena));
+        }
+        document.root_ = CompactNode::MakeArray(elements, static_cast<uint32_t>(count));
+        return std::make_pair(std::move(document), close + 1);
+    }
+};
+
+CompactDocument Parser::ReadCompact(size_t thread_count) {
+    if (!IsContiguous()) {
+        throw std::logic_error("Compact reading needs the whole input in memory"s);
     }
+    if (!SkipWhitespace()) {
+        throw ParsingError("Unexpected EOF"s);
+    }
+    size_t consumed = 0;
+    CompactDocument document = CompactLoader::Load({cur_, static_cast<size_t>(end_ - cur_)}, thread_count, consumed);
+    cur_ += consumed;
+    return document;
 }
 
+namespace {
+
 struct PrintContext {
-    std::ostream& out;
+    OutputBuffer& out;
+    const PrintSettings& settings;
     int indent_step = 4;
     int indent = 0;
 
     void PrintIndent() const {
-        for (int i = 0; i < indent; ++i) {
-            out.put(' ');
-        }
+        json::PrintIndent(indent, out, settings);
+    }
+
+    void PrintLineBreak() const {
+        json::PrintLineBreak(out, settings);
     }
 
     PrintContext Indented() const {
-        return {out, indent_step, indent_step + indent};
+        return {out, settings, indent_step, indent_step + indent};
     }
 };
 
 void PrintNode(const Node& value, const PrintContext& ctx);
 
 template <typename Value>
-void PrintValue(const Value& value, const PrintContext& ctx) {
-    ctx.out << value;
+void PrintValue(const Value& value, const PrintContext& ctx);
+
+template <>
+void PrintValue<int>(const int& value, const PrintContext& ctx) {
+    PrintNumber(value, ctx.out);
 }
 
-void PrintString(const std::string& value, std::ostream& out) {
-    out.put('"');
-    for (const char c : value) {
-        switch (c) {
-            case '\r':
-                out << "\\r"sv;
-                break;
-            case '\n':
-                out << "\\n"sv;
-                break;
-            case '"':
-                // Символы " и \ выводятся как \" или \\, соответственно
-                [[fallthrough]];
-            case '\\':
-                out.put('\\');
-                [[fallthrough]];
-            default:
-                out.put(c);
-                break;
-        }
+template <>
+void PrintValue<double>(const double& value, const PrintContext& ctx) {
+    PrintNumber(value, ctx.out, ctx.settings);
+}
+
+std::to_chars_result FormatDouble(char* first, char* last, double value, const PrintSettings& settings) {
+    switch (settings.number_format) {
+        case NumberFormat::SHORTEST:
+            return std::to_chars(first, last, value);
+        case NumberFormat::FIXED:
+            return std::to_chars(first, last, value, std::chars_format::fixed, settings.precision);
+        case NumberFormat::GENERAL:
+        default:
+            return std::to_chars(first, last, value, std::chars_format::general, settings.precision);
     }
-    out.put('"');
+}
+
+bool NeedsEscape(char c) {
+    return c == '\r' || c == '\n' || c == '"' || c == '\\';
 }
 
 template <>
@@ -276,7 +935,7 @@ void PrintValue<std::string>(const std::string& value, const PrintContext& ctx)
 
 template <>
 void PrintValue<std::nullptr_t>(const std::nullptr_t&, const PrintContext& ctx) {
-    ctx.out << "null"sv;
+    ctx.out.Write("null"sv);
 }
 
 // В специализаци шаблона PrintValue для типа bool параметр value передаётся
@@ -285,49 +944,53 @@ void PrintValue<std::nullptr_t>(const std::nullptr_t&, const PrintContext& ctx)
 // void PrintValue(bool value, const PrintContext& ctx);
 template <>
 void PrintValue<bool>(const bool& value, const PrintContext& ctx) {
-    ctx.out << (value ? "true"sv : "false"sv);
+    ctx.out.Write(value ? "true"sv : "false"sv);
 }
 
 template <>
 void PrintValue<Array>(const Array& nodes, const PrintContext& ctx) {
-    std::ostream& out = ctx.out;
-    out << "[\n"sv;
+    OutputBuffer& out = ctx.out;
+    out.Put('[');
+    ctx.PrintLineBreak();
     bool first = true;
     auto inner_ctx = ctx.Indented();
     for (const Node& node : nodes) {
         if (first) {
             first = false;
         } else {
-            out << ",\n"sv;
+            out.Put(',');
+            ctx.PrintLineBreak();
         }
         inner_ctx.PrintIndent();
         PrintNode(node, inner_ctx);
+        out.Commit();
     }
-    out.put('\n');
+    ctx.PrintLineBreak();
     ctx.PrintIndent();
-    out.put(']');
+    out.Put(']');
 }
 
 template <>
 void PrintValue<Dict>(const Dict& nodes, const PrintContext& ctx) {
-    std::ostream& out = ctx.out;
-    out << "{\n"sv;
+    OutputBuffer& out = ctx.out;
+    out.Put('{');
+    ctx.PrintLineBreak();
     bool first = true;
     auto inner_ctx = ctx.Indented();
     for (const auto& [key, node] : nodes) {
         if (first) {
             first = false;
         } else {
-            out << ",\n"sv;
+            out.Put(',');
+            ctx.PrintLineBreak();
         }
         inner_ctx.PrintIndent();
-        PrintString(key, ctx.out);
-        out << ": "sv;
+        PrintKey(key, out, ctx.settings);
         PrintNode(node, inner_ctx);
     }
-    out.put('\n');
+    ctx.PrintLineBreak();
     ctx.PrintIndent();
-    out.put('}');
+    out.Put('}');
 }
 
 void PrintNode(const Node& node, const PrintContext& ctx) {
@@ -341,11 +1004,263 @@ void PrintNode(const Node& node, const PrintContext& ctx) {
 }  // namespace
 
 Document Load(std::istream& input) {
-    return Document{LoadNode(input)};
+    return Document{Parser(input).LoadNode()};
+}
+
+Document Load(std::string_view input) {
+    return Document{Parser(input).LoadNode()};
+}
+
+StreamReader::StreamReader(std::istream& input)
+    : parser_(std::make_unique<Parser>(input)) {
+}
+
+StreamReader::StreamReader(std::string_view input)
+    : parser_(std::make_unique<Parser>(input)) {
+}
+
+StreamReader::~StreamReader() = default;
+
+void StreamReader::BeginDict() {
+    parser_->Begin('{');
+}
+
+bool StreamReader::NextKey(std::string& key) {
+    return parser_->NextKey(key);
+}
+
+void StreamReader::BeginArray() {
+    parser_->Begin('[');
+}
+
+bool StreamReader::NextElement() {
+    return parser_->NextElement();
+}
+
+Node StreamReader::ReadNode() {
+    return parser_->LoadNode();
+}
+
+bool StreamReader::IsContiguous() const {
+    return parser_->IsContiguous();
+}
+
+CompactDocument StreamReader::ReadCompact(size_t thread_count) {
+    return parser_->ReadCompact(thread_count);
+}
+
+CompactNode CompactNode::MakeBool(bool value) {
+    CompactNode node;
+    node.type_ = Type::BOOL;
+    node.value_.bool_value = value;
+    return node;
+}
+
+CompactNode CompactNode::MakeInt(int value) {
+    CompactNode node;
+    node.type_ = Type::INT;
+    node.value_.int_value = value;
+    return node;
+}
+
+CompactNode CompactNode::MakeDouble(double value) {
+    CompactNode node;
+    node.type_ = Type::DOUBLE;
+    node.value_.double_value = value;
+    return node;
+}
+
+CompactNode CompactNode::MakeString(std::string_view value) {
+    CompactNode node;
+    node.type_ = Type::STRING;
+    node.size_ = static_cast<uint32_t>(value.size());
+    node.value_.chars = value.data();
+    return node;
+}
+
+CompactNode CompactNode::MakeArray(const CompactNode* items, uint32_t size) {
+    CompactNode node;
+    node.type_ = Type::ARRAY;
+    node.size_ = size;
+    node.value_.items = items;
+    return node;
+}
+
+CompactNode CompactNode::MakeDict(const CompactMember* members, uint32_t size) {
+    CompactNode node;
+    node.type_ = Type::DICT;
+    node.size_ = size;
+    node.value_.members = members;
+    return node;
+}
+
+bool CompactNode::AsBool() const {
+    if (!IsBool()) {
+        throw std::logic_error("Not a bool"s);
+    }
+    return value_.bool_value;
+}
+
+int CompactNode::AsInt() const {
+    if (!IsInt()) {
+        throw std::logic_error("Not an int"s);
+    }
+    return value_.int_value;
+}
+
+double CompactNode::AsDouble() const {
+    if (!IsDouble()) {
+        throw std::logic_error("Not a double"s);
+    }
+    return IsPureDouble() ? value_.double_value : value_.int_value;
+}
+
+std::string_view CompactNode::AsString() const {
+    if (!IsString()) {
+        throw std::logic_error("Not a string"s);
+    }
+    return {value_.chars, size_};
+}
+
+const CompactNode& CompactArray::at(size_t index) const {
+    if (index >= size_) {
+        throw std::out_of_range("Array index is out of range"s);
+    }
+    return items_[index];
+}
+
+const CompactMember* CompactDict::find(std::string_view key) const {
+    const CompactMember* it = std::lower_bound(begin(), end(), key, [](const CompactMember& member, std::string_view key) {
+        return member.key < key;
+    });
+    return it != end() && it->key == key ? it : end();
+}
+
+const CompactNode& CompactDict::at(std::string_view key) const {
+    const CompactMember* it = find(key);
+    if (it == end()) {
+        throw std::out_of_range("Key '"s + std::string(key) + "' is not found"s);
+    }
+    return it->value;
+}
+
+CompactDocument LoadCompact(std::string_view input) {
+    size_t consumed = 0;
+    return CompactLoader::Load(input, 1, consumed);
+}
+
+CompactDocument LoadCompact(std::istream& input) {
+    return CompactLoader::LoadOwned(std::string(std::istreambuf_iterator<char>(input), {}));
+}
+
+CompactDocument LoadCompactParallel(std::string_view input, size_t thread_count) {
+    size_t consumed = 0;
+    return CompactLoader::Load(input, thread_count, consumed);
+}
+
+OutputBuffer::OutputBuffer(std::ostream& output)
+    : out_(output) {
+    buffer_.reserve(FLUSH_SIZE + FLUSH_SIZE / 4);
+}
+
+OutputBuffer::~OutputBuffer() {
+    Flush();
+}
+
+void OutputBuffer::Flush() {
+    out_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    buffer_.clear();
+}
+
+std::optional<NumberFormat> ParseNumberFormat(std::string_view name) {
+    if (name == "general"sv) {
+        return NumberFormat::GENERAL;
+    }
+    if (name == "shortest"sv) {
+        return NumberFormat::SHORTEST;
+    }
+    if (name == "fixed"sv) {
+        return NumberFormat::FIXED;
+    }
+    return std::nullopt;
+}
+
+void PrintLineBreak(OutputBuffer& out, const PrintSettings& settings) {
+    if (!settings.compact) {
+        out.Put('\n');
+    }
+}
+
+void PrintIndent(int indent, OutputBuffer& out, const PrintSettings& settings) {
+    if (settings.compact) {
+        return;
+    }
+    static constexpr std::string_view SPACES = "                                "sv;
+    for (int left = indent; left > 0; left -= static_cast<int>(SPACES.size())) {
+        out.Write(SPACES.substr(0, std::min<size_t>(left, SPACES.size())));
+    }
+}
+
+void PrintString(std::string_view value, OutputBuffer& out) {
+    out.Put('"');
+    //runs of ordinary characters are copied in one piece
+    const char* pos = value.data();
+    const char* const end = pos + value.size();
+    while (pos != end) {
+        const char* run_end = std::find_if(pos, end, NeedsEscape);
+        out.Write({pos, static_cast<size_t>(run_end - pos)});
+        if (run_end == end) {
+            break;
+        }
+        switch (*run_end) {
+            case '\r':
+                out.Write("\\r"sv);
+                break;
+            case '\n':
+                out.Write("\\n"sv);
+                break;
+            default:
+                // Символы " и \ выводятся как \" или \\, соответственно
+                out.Put('\\');
+                out.Put(*run_end);
+                break;
+        }
+        pos = run_end + 1;
+    }
+    out.Put('"');
+}
+
+void PrintKey(std::string_view key, OutputBuffer& out, const PrintSettings& settings) {
+    PrintString(key, out);
+    out.Write(settings.compact ? ":"sv : ": "sv);
+}
+
+void PrintNumber(int value, OutputBuffer& out) {
+    char buffer[16];
+    const auto result = std::to_chars(std::begin(buffer), std::end(buffer), value);
+    out.Write({buffer, static_cast<size_t>(result.ptr - buffer)});
+}
+
+void PrintNumber(double value, OutputBuffer& out, const PrintSettings& settings) {
+    char buffer[64];
+    const auto result = FormatDouble(std::begin(buffer), std::end(buffer), value, settings);
+    if (result.ec == std::errc{}) {
+        out.Write({buffer, static_cast<size_t>(result.ptr - buffer)});
+        return;
+    }
+    //fixed notation of a large number or a large precision does not fit on the stack
+    std::string large(512 + std::max(settings.precision, 0), '\0');
+    const auto large_result = FormatDouble(large.data(), large.data() + large.size(), value, settings);
+    out.Write({large.data(), static_cast<size_t>(large_result.ptr - large.data())});
+}
+
+void PrintNode(const Node& node, OutputBuffer& out, const PrintSettings& settings, int indent) {
+    PrintNode(node, PrintContext{out, settings, 4, indent});
 }
 
-void Print(const Document& doc, std::ostream& output) {
-    PrintNode(doc.GetRoot(), PrintContext{output});
+void Print(const Document& doc, std::ostream& output, const PrintSettings& settings) {
+    OutputBuffer out(output);
+    PrintNode(doc.GetRoot(), PrintContext{out, settings});
 }
 
-}  // namespace json
\ No newline at end of file
+}  // namespace json
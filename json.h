@@ -1,8 +1,13 @@
 #pragma once
 
+#include <cstdint>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <memory_resource>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
@@ -139,8 +144,287 @@ inline bool operator!=(const Document& lhs, const Document& rhs) {
     return !(lhs == rhs);
 }
 
+class Parser;
+class CompactDocument;
+
+// Потоковый разбор: значения верхних уровней читаются по одному, без построения всего дерева.
+//     reader.BeginDict();
+//     while (reader.NextKey(key)) { auto value = reader.ReadNode(); ... }
+// Вложенные значения, прочитанные через ReadNode, строятся целиком.
+class StreamReader {
+public:
+    explicit StreamReader(std::istream& input);
+    explicit StreamReader(std::string_view input);
+    ~StreamReader();
+
+    void BeginDict();
+    // Читает следующий ключ словаря, false - словарь закончился
+    bool NextKey(std::string& key);
+    void BeginArray();
+    // Переходит к следующему элементу массива, false - массив закончился
+    bool NextElement();
+    Node ReadNode();
+
+    // true, если вход целиком лежит в памяти (создан из string_view)
+    bool IsContiguous() const;
+    // Читает следующее значение компактным деревом, массивы - на thread_count потоках.
+    // Строки ссылаются на вход. Только для IsContiguous(), иначе std::logic_error
+    CompactDocument ReadCompact(size_t thread_count);
+
+private:
+    std::unique_ptr<Parser> parser_;
+};
+
 Document Load(std::istream& input);
+// Разбирает документ прямо из буфера в памяти, без копирования входа
+Document Load(std::string_view input);
+
+struct CompactMember;
+class CompactArray;
+class CompactDict;
+
+// Узел компактного дерева только для чтения: 16 байт, тип и значение либо ссылка
+// на элементы. Строки без escape-последовательностей указывают прямо во входной буфер
+class CompactNode {
+public:
+    enum class Type : uint8_t {
+        NUL,
+        BOOL,
+        INT,
+        DOUBLE,
+        STRING,
+        ARRAY,
+        DICT,
+    };
+
+    CompactNode() = default;
+
+    static CompactNode MakeBool(bool value);
+    static CompactNode MakeInt(int value);
+    static CompactNode MakeDouble(double value);
+    static CompactNode MakeString(std::string_view value);
+    static CompactNode MakeArray(const CompactNode* items, uint32_t size);
+    static CompactNode MakeDict(const CompactMember* members, uint32_t size);
+
+    Type GetType() const {
+        return type_;
+    }
+
+    bool IsNull() const {
+        return type_ == Type::NUL;
+    }
+    bool IsBool() const {
+        return type_ == Type::BOOL;
+    }
+    bool IsInt() const {
+        return type_ == Type::INT;
+    }
+    bool IsPureDouble() const {
+        return type_ == Type::DOUBLE;
+    }
+    bool IsDouble() const {
+        return IsInt() || IsPureDouble();
+    }
+    bool IsString() const {
+        return type_ == Type::STRING;
+    }
+    bool IsArray() const {
+        return type_ == Type::ARRAY;
+    }
+    bool IsDict() const {
+        return type_ == Type::DICT;
+    }
+
+    bool AsBool() const;
+    int AsInt() const;
+    double AsDouble() const;
+    std::string_view AsString() const;
+    CompactArray AsArray() const;
+    CompactDict AsDict() const;
+
+private:
+    Type type_ = Type::NUL;
+    uint32_t size_ = 0;
+    union Payload {
+        bool bool_value;
+        int int_value;
+        double double_value;
+        const char* chars;
+        const CompactNode* items;
+        const CompactMember* members;
+    } value_{};
+};
+
+struct CompactMember {
+    std::string_view key;
+    CompactNode value;
+};
+
+// Массив компактного дерева, аналог const Array&
+class CompactArray {
+public:
+    CompactArray(const CompactNode* items, size_t size)
+        : items_(items)
+        , size_(size) {
+    }
+
+    const CompactNode* begin() const {
+        return items_;
+    }
+    const CompactNode* end() const {
+        return items_ + size_;
+    }
+    size_t size() const {
+        return size_;
+    }
+    bool empty() const {
+        return size_ == 0;
+    }
+    const CompactNode& operator[](size_t index) const {
+        return items_[index];
+    }
+    const CompactNode& at(size_t index) const;
+
+private:
+    const CompactNode* items_;
+    size_t size_;
+};
+
+// Словарь компактного дерева, аналог const Dict&: пары отсортированы по ключу,
+// поиск двоичный, обход в том же порядке, что и у std::map
+class CompactDict {
+public:
+    CompactDict(const CompactMember* members, size_t size)
+        : members_(members)
+        , size_(size) {
+    }
+
+    const CompactMember* begin() const {
+        return members_;
+    }
+    const CompactMember* end() const {
+        return members_ + size_;
+    }
+    size_t size() const {
+        return size_;
+    }
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    const CompactMember* find(std::string_view key) const;
+    size_t count(std::string_view key) const {
+        return find(key) != end() ? 1 : 0;
+    }
+    const CompactNode& at(std::string_view key) const;
+
+private:
+    const CompactMember* members_;
+    size_t size_;
+};
+
+inline CompactArray CompactNode::AsArray() const {
+    using namespace std::literals;
+    if (!IsArray()) {
+        throw std::logic_error("Not an array"s);
+    }
+    return {value_.items, size_};
+}
+
+inline CompactDict CompactNode::AsDict() const {
+    using namespace std::literals;
+    if (!IsDict()) {
+        throw std::logic_error("Not a dict"s);
+    }
+    return {value_.members, size_};
+}
+
+// Документ компактного дерева. Все узлы и разобранные строки лежат в монотонной арене
+// документа и освобождаются разом вместе с ним
+class CompactDocument {
+public:
+    const CompactNode& GetRoot() const {
+        return root_;
+    }
+
+private:
+    friend class CompactLoader;
+
+    // При параллельном разборе у каждого потока своя арена
+    std::vector<std::unique_ptr<std::pmr::monotonic_buffer_resource>> arenas_;
+    CompactNode root_;
+};
+
+// Строит компактное дерево по буферу. Строки ссылаются на input, он должен жить дольше документа
+CompactDocument LoadCompact(std::string_view input);
+// Читает поток целиком в арену документа и строит по нему компактное дерево
+CompactDocument LoadCompact(std::istream& input);
+// То же, что LoadCompact(input), но большой массив верхнего уровня разбирается на thread_count потоках.
+// Сначала по структурным символам находятся границы элементов, затем отрезки элементов
+// разбираются параллельно, каждый поток в свою арену, и склеиваются в исходном порядке.
+// Результат, включая ошибки разбора, совпадает с последовательным LoadCompact
+CompactDocument LoadCompactParallel(std::string_view input, size_t thread_count);
+
+// Формат вывода чисел с плавающей точкой
+enum class NumberFormat {
+    // Как ostream по умолчанию: %g с precision значащими цифрами
+    GENERAL,
+    // Кратчайшая запись, которая читается обратно в то же самое число, precision не используется
+    SHORTEST,
+    // Ровно precision знаков после точки
+    FIXED,
+};
+
+struct PrintSettings {
+    NumberFormat number_format = NumberFormat::GENERAL;
+    int precision = 6;
+    // Без переводов строк и отступов, ключи в том же порядке
+    bool compact = false;
+};
+
+// Формат по имени: "general", "shortest" или "fixed", nullopt для других имён
+std::optional<NumberFormat> ParseNumberFormat(std::string_view name);
+
+// Буфер вывода: мелкие записи копятся в строке и уходят в поток крупными блоками
+class OutputBuffer {
+public:
+    explicit OutputBuffer(std::ostream& output);
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+    ~OutputBuffer();
+
+    void Put(char c) {
+        buffer_.push_back(c);
+    }
+    void Write(std::string_view str) {
+        buffer_.append(str);
+    }
+    // Отдаёт накопленное в поток, если буфер заполнен
+    void Commit() {
+        if (buffer_.size() >= FLUSH_SIZE) {
+            Flush();
+        }
+    }
+    void Flush();
+
+private:
+    static constexpr size_t FLUSH_SIZE = 64 * 1024;
+
+    std::ostream& out_;
+    std::string buffer_;
+};
+
+void Print(const Document& doc, std::ostream& output, const PrintSettings& settings = {});
 
-void Print(const Document& doc, std::ostream& output);
+// Части Print для потоковой записи без построения дерева, см. json::Writer.
+// PrintLineBreak и PrintIndent ничего не пишут в компактном режиме
+void PrintLineBreak(OutputBuffer& out, const PrintSettings& settings);
+void PrintIndent(int indent, OutputBuffer& out, const PrintSettings& settings);
+void PrintKey(std::string_view key, OutputBuffer& out, const PrintSettings& settings);
+void PrintString(std::string_view value, OutputBuffer& out);
+void PrintNumber(int value, OutputBuffer& out);
+void PrintNumber(double value, OutputBuffer& out, const PrintSettings& settings);
+// Печатает узел так, будто он вложен в Print с отступом indent
+void PrintNode(const Node& node, OutputBuffer& out, const PrintSettings& settings, int indent);
 
 }  // namespace json
\ No newline at end of file
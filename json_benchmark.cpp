@@ -0,0 +1,119 @@
+#include "json.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <streambuf>
+#include <string>
+
+// Скорость json::Print и json::Load в МБ/с на документе из ответов, похожих на ответы Route:
+// в основном числа с плавающей точкой, короткие строки с экранированием и одна строка SVG.
+// Запуск: json_benchmark [число ответов, по умолчанию 200000] [число повторов, по умолчанию 5]
+
+using namespace std::literals;
+
+namespace {
+
+// Поток, который только считает байты: печать меряется без затрат на запись
+class CountingBuffer : public std::streambuf {
+public:
+    size_t GetSize() const {
+        return size_;
+    }
+
+protected:
+    int_type overflow(int_type c) override {
+        ++size_;
+        return c;
+    }
+    std::streamsize xsputn(const char*, std::streamsize count) override {
+        size_ += static_cast<size_t>(count);
+        return count;
+    }
+
+private:
+    size_t size_ = 0;
+};
+
+json::Document MakeDocument(int responses) {
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> time(0, 200);
+    std::uniform_real_distribution<double> curvature(0.9, 3.5);
+    std::uniform_real_distribution<double> wide(-1e12, 1e12);
+
+    json::Array items;
+    items.reserve(responses + 1);
+    for (int i = 0; i < responses; ++i) {
+        json::Array route;
+        for (int j = 0; j < 4; ++j) {
+            route.push_back(json::Dict{{"type"s, "Wait"s}, {"stop_name"s, "Stop \""s + std::to_string(j) + "\"\n"s}, {"time"s, time(rng)}});
+            route.push_back(json::Dict{{"type"s, "Bus"s}, {"bus"s, "b"s + std::to_string(j)}, {"span_count"s, j}, {"time"s, time(rng)}});
+        }
+        items.push_back(json::Dict{{"request_id"s, i}, {"total_time"s, time(rng)}, {"curvature"s, curvature(rng)},
+                                   {"x"s, wide(rng)}, {"tiny"s, wide(rng) * 1e-300}, {"items"s, std::move(route)}});
+    }
+
+    std::string svg = "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">\n"s;
+    for (int i = 0; i < 1000; ++i) {
+        svg += "  <text fill=\"black\" x=\""s + std::to_string(time(rng)) + "\" y=\""s + std::to_string(time(rng))
+             + "\" font-family=\"Verdana\">Stop "s + std::to_string(i) + "</text>\n"s;
+    }
+    svg += "</svg>"s;
+    items.push_back(json::Dict{{"request_id"s, responses}, {"map"s, std::move(svg)}});
+
+    return json::Document{json::Node(std::move(items))};
+}
+
+template <typename Function>
+double BestSeconds(int repeats, Function function) {
+    double best = 0.0;
+    for (int i = 0; i < repeats; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        function();
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = i == 0 ? seconds : std::min(best, seconds);
+    }
+    return best;
+}
+
+void PrintResult(std::string_view name, size_t bytes, double seconds) {
+    std::cout << name << ": "sv << bytes / 1e6 << " MB, "sv << bytes / 1e6 / seconds << " MB/s\n"sv;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    const int responses = argc > 1 ? std::stoi(argv[1]) : 200000;
+    const int repeats = argc > 2 ? std::stoi(argv[2]) : 5;
+    const json::Document document = MakeDocument(responses);
+
+    struct Format {
+        std::string_view name;
+        json::NumberFormat number_format;
+    };
+    const Format formats[] = {
+        {"general"sv, json::NumberFormat::GENERAL},
+        {"shortest"sv, json::NumberFormat::SHORTEST},
+        {"fixed"sv, json::NumberFormat::FIXED},
+    };
+    for (const auto& format : formats) {
+        for (bool compact : {false, true}) {
+            json::PrintSettings settings;
+            settings.number_format = format.number_format;
+            settings.compact = compact;
+
+            CountingBuffer buffer;
+            std::ostream output(&buffer);
+            const double seconds = BestSeconds(repeats, [&] { json::Print(document, output, settings); });
+            PrintResult("print "s + std::string(format.name) + (compact ? " compact"s : " pretty"s), buffer.GetSize() / repeats, seconds);
+        }
+    }
+
+    std::ostringstream printed;
+    json::Print(document, printed);
+    const std::string text = printed.str();
+    const double seconds = BestSeconds(repeats, [&] { json::Load(std::string_view(text)); });
+    PrintResult("load general pretty"sv, text.size(), seconds);
+}
@@ -1,5 +1,7 @@
 #include "json_builder.h"
 
+using namespace std::literals;
+
 namespace json {
 
 	Builder::DictKeyContext Builder::Key(std::string string) {
@@ -130,4 +132,159 @@ namespace json {
 		}
 		return root_;
 	}
+
+	Writer::Writer(OutputBuffer& out, const PrintSettings& settings)
+		: out_(out)
+		, settings_(settings) {
+	}
+
+	void Writer::BeginValue()
+	{
+		if (frames_.empty()) {
+			if (constructed_) {
+				throw std::logic_error("Invalid command");
+			}
+			return;
+		}
+		Frame& frame = frames_.back();
+		if (frame.is_dict) {
+			if (!key_written_) {
+				throw std::logic_error("Invalid command");
+			}
+			key_written_ = false;
+			return;
+		}
+		if (!frame.empty) {
+			out_.Put(',');
+			PrintLineBreak(out_, settings_);
+		}
+		frame.empty = false;
+		PrintIndent(GetIndent(), out_, settings_);
+	}
+
+	void Writer::EndValue()
+	{
+		if (frames_.empty()) {
+			constructed_ = true;
+		}
+		//a finished element of the top-level array goes to the stream at once, so a streamed answer is not held back
+		if (frames_.size() <= 1) {
+			out_.Flush();
+		}
+	}
+
+	Writer& Writer::Key(std::string_view key)
+	{
+		if (frames_.empty() || !frames_.back().is_dict || key_written_) {
+			throw std::logic_error("Invalid command");
+		}
+		Frame& frame = frames_.back();
+		if (!frame.empty) {
+			out_.Put(',');
+			PrintLineBreak(out_, settings_);
+		}
+		frame.empty = false;
+		PrintIndent(GetIndent(), out_, settings_);
+		PrintKey(key, out_, settings_);
+		key_written_ = true;
+		return *this;
+	}
+
+	Writer& Writer::Value(std::nullptr_t)
+	{
+		BeginValue();
+		out_.Write("null"sv);
+		EndValue();
+		return *this;
+	}
+
+	Writer& Writer::Value(bool value)
+	{
+		BeginValue();
+		out_.Write(value ? "true"sv : "false"sv);
+		EndValue();
+		return *this;
+	}
+
+	Writer& Writer::Value(int value)
+	{
+		BeginValue();
+		PrintNumber(value, out_);
+		EndValue();
+		return *this;
+	}
+
+	Writer& Writer::Value(double value)
+	{
+		BeginValue();
+		PrintNumber(value, out_, settings_);
+		EndValue();
+		return *this;
+	}
+
+	Writer& Writer::Value(std::string_view value)
+	{
+		BeginValue();
+		PrintString(value, out_);
+		EndValue();
+		return *this;
+	}
+
+	Writer& Writer::Value(const Node& value)
+	{
+		BeginValue();
+		PrintNode(value, out_, settings_, GetIndent());
+		EndValue();
+		return *this;
+	}
+
+	Writer& Writer::StartDict()
+	{
+		BeginValue();
+		out_.Put('{');
+		PrintLineBreak(out_, settings_);
+		frames_.push_back({ true });
+		return *this;
+	}
+
+	Writer& Writer::StartArray()
+	{
+		BeginValue();
+		out_.Put('[');
+		PrintLineBreak(out_, settings_);
+		frames_.push_back({ false });
+		return *this;
+	}
+
+	void Writer::EndContainer(bool is_dict, char close)
+	{
+		if (frames_.empty() || frames_.back().is_dict != is_dict || key_written_) {
+			throw std::logic_error("Invalid command");
+		}
+		frames_.pop_back();
+		PrintLineBreak(out_, settings_);
+		PrintIndent(GetIndent(), out_, settings_);
+		out_.Put(close);
+		EndValue();
+	}
+
+	Writer& Writer::EndDict()
+	{
+		EndContainer(true, '}');
+		return *this;
+	}
+
+	Writer& Writer::EndArray()
+	{
+		EndContainer(false, ']');
+		return *this;
+	}
+
+	void Writer::Finish()
+	{
+		if (!constructed_) {
+			throw std::logic_error(frames_.empty() ? "Node must be not empty" : "Not closed dict or array");
+		}
+		out_.Flush();
+	}
 }
@@ -3,6 +3,8 @@
 #include "json.h"
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace json {
 
@@ -79,4 +81,49 @@ namespace json {
 			Builder& builder_;
 		};
 	};
+
+	// Потоковая запись JSON с тем же интерфейсом, что у Builder: значения сразу пишутся
+	// в буфер вывода в формате json::Print, дерево не строится. Порядок вызовов проверяется
+	// так же, при ошибке бросается std::logic_error.
+	// Ключи словаря выводятся в порядке вызова Key; чтобы вывод совпадал с Print для Dict,
+	// их нужно передавать по возрастанию.
+	// Каждый законченный элемент массива верхнего уровня сразу отдаётся в поток
+	class Writer {
+	public:
+		explicit Writer(OutputBuffer& out, const PrintSettings& settings = {});
+
+		Writer& Key(std::string_view key);
+		Writer& Value(std::nullptr_t);
+		Writer& Value(bool value);
+		Writer& Value(int value);
+		Writer& Value(double value);
+		Writer& Value(std::string_view value);
+		Writer& Value(const std::string& value) { return Value(std::string_view(value)); }
+		Writer& Value(const char* value) { return Value(std::string_view(value)); }
+		Writer& Value(const Node& value);
+		Writer& StartDict();
+		Writer& EndDict();
+		Writer& StartArray();
+		Writer& EndArray();
+		// Проверяет, что записано одно значение верхнего уровня и все контейнеры закрыты
+		void Finish();
+
+	private:
+		struct Frame {
+			bool is_dict;
+			bool empty = true;
+		};
+
+		OutputBuffer& out_;
+		PrintSettings settings_;
+		std::vector<Frame> frames_;
+		bool key_written_ = false;
+		bool constructed_ = false;
+
+		int GetIndent() const { return static_cast<int>(frames_.size()) * 4; }
+		// Разделитель и отступ перед очередным значением, проверка порядка вызовов
+		void BeginValue();
+		void EndValue();
+		void EndContainer(bool is_dict, char close);
+	};
 }
\ No newline at end of file
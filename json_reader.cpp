@@ -1,47 +1,84 @@
 #include "json_reader.h"
 
-void JsonReader::ParseStops(trans_ctl::TransportCatalogue& catalogue, const json::Document& document)
+#include <stdexcept>
+#include <thread>
+
+namespace {
+	// Число потоков для разбора больших массивов запросов
+	size_t GetParseThreads() {
+		return std::max(1u, std::thread::hardware_concurrency());
+	}
+}
+
+template <typename DictType>
+void JsonReader::ParseBaseRequest(trans_ctl::TransportCatalogue& catalogue, const DictType& base_request, BaseRequests& pending) const
 {
-	const auto& base_requests_ = document.GetRoot().AsDict().at("base_requests").AsArray();
-	for (const auto& base_request : base_requests_) {
-		if (base_request.AsDict().at("type").AsString() == "Stop") {
-			trans_ctl::Stop stop;
-			stop.name = base_request.AsDict().at("name").AsString();
-			stop.coordinates = { base_request.AsDict().at("latitude").AsDouble(), base_request.AsDict().at("longitude").AsDouble() };
-			catalogue.AddStop(std::move(stop));
+	const auto& type = base_request.at("type").AsString();
+	if (type == "Stop") {
+		ParseStop(catalogue, base_request, pending);
+	}
+	else if (type == "Bus") {
+		ParseBus(catalogue, base_request, pending);
+	}
+}
+
+template <typename DictType>
+void JsonReader::ParseStop(trans_ctl::TransportCatalogue& catalogue, const DictType& base_request, BaseRequests& pending) const
+{
+	trans_ctl::Stop stop;
+	stop.name = base_request.at("name").AsString();
+	stop.coordinates = { base_request.at("latitude").AsDouble(), base_request.at("longitude").AsDouble() };
+	catalogue.AddStop(std::move(stop));
+
+	trans_ctl::Stop* first_stop = catalogue.FindStop(base_request.at("name").AsString());
+	const auto& road_distances_ = base_request.at("road_distances").AsDict();
+	for (const auto& [name_second_stop, distance] : road_distances_) {
+		trans_ctl::Stop* second_stop = catalogue.FindStop(name_second_stop);
+		if (second_stop != nullptr) {
+			catalogue.SetStopsLength(first_stop, second_stop, distance.AsDouble());
+		}
+		else {
+			pending.distances.push_back({ first_stop, std::string(name_second_stop), distance.AsDouble() });
 		}
 	}
 }
 
-void JsonReader::ParseStopsLength(trans_ctl::TransportCatalogue& catalogue, const json::Document& document)
+template <typename DictType>
+void JsonReader::ParseBus(trans_ctl::TransportCatalogue& catalogue, const DictType& base_request, BaseRequests& pending) const
 {
-	const auto& base_requests_ = document.GetRoot().AsDict().at("base_requests").AsArray();
-	for (const auto& base_request : base_requests_) {
-		if (base_request.AsDict().at("type").AsString() == "Stop") {
-			std::string_view name_first_stop = base_request.AsDict().at("name").AsString();
-			const auto& road_distances_ = base_request.AsDict().at("road_distances").AsDict();
-			for (const auto& [name_second_stop, distance] : road_distances_) {
-				catalogue.SetStopsLength(catalogue.FindStop(name_first_stop), catalogue.FindStop(name_second_stop), distance.AsDouble());
-			}
+	//buses are added after all stops, in input order, so that bus ids do not depend on where stops are listed
+	PendingBus pending_bus;
+	trans_ctl::Bus& bus_ = pending_bus.bus;
+	bus_.name = base_request.at("name").AsString();
+	bus_.isCircleRoute = base_request.at("is_roundtrip").AsBool();
+	const auto& stops_ = base_request.at("stops").AsArray();
+	bus_.stops.reserve(stops_.size());
+	for (const auto& stop_ : stops_) {
+		trans_ctl::Stop* stop = catalogue.FindStop(stop_.AsString());
+		if (stop == nullptr) {
+			pending_bus.unresolved_stops.push_back({ bus_.stops.size(), std::string(stop_.AsString()) });
 		}
+		bus_.stops.push_back(stop);
 	}
+	pending.buses.push_back(std::move(pending_bus));
 }
 
-void JsonReader::ParseBus(trans_ctl::TransportCatalogue& catalogue, const json::Document& document)
+void JsonReader::FinishBaseRequests(trans_ctl::TransportCatalogue& catalogue, BaseRequests& pending) const
 {
-	const auto& base_requests_ = document.GetRoot().AsDict().at("base_requests").AsArray();
-	for (const auto& base_request : base_requests_) {
-		if (base_request.AsDict().at("type").AsString() == "Bus") {
-			trans_ctl::Bus bus_;
-			bus_.name = base_request.AsDict().at("name").AsString();
-			bus_.isCircleRoute = base_request.AsDict().at("is_roundtrip").AsBool();
-			const auto& stops_ = base_request.AsDict().at("stops").AsArray();
-			for (const auto& stop_ : stops_) {
-				bus_.stops.push_back(catalogue.FindStop(stop_.AsString()));
-			}
-			catalogue.AddBus(std::move(bus_));
+	//fix-up pass for forward references
+	for (const auto& [first_stop, name_second_stop, distance] : pending.distances) {
+		catalogue.SetStopsLength(first_stop, catalogue.FindStop(name_second_stop), distance);
+	}
+	for (auto& [bus, unresolved_stops] : pending.buses) {
+		for (const auto& [position, stop_name] : unresolved_stops) {
+			bus.stops[position] = catalogue.FindStop(stop_name);
 		}
+		catalogue.AddBus(std::move(bus));
 	}
+
+	catalogue.BuildStopBuses();
+	catalogue.BuildSpatialIndex();
+	catalogue.BuildNameIndexes();
 }
 
 svg::Color JsonReader::ParseColor(const json::Node& color) const
@@ -99,142 +136,460 @@ std::string JsonReader::ParseSerializationSettings(const json::Document& documen
 	return document.GetRoot().AsDict().at("serialization_settings").AsDict().at("file").AsString();
 }
 
-void JsonReader::ReadJSON(trans_ctl::TransportCatalogue& catalogue, const json::Document& document)
+std::string JsonReader::ParseBaseFormat(const json::Document& document) const
+{
+	const auto& settings_ = document.GetRoot().AsDict().at("serialization_settings").AsDict();
+	const auto format = settings_.find("format"s);
+	return format != settings_.end() ? format->second.AsString() : "protobuf"s;
+}
+
+bool JsonReader::ParseBaseCompression(const json::Document& document) const
+{
+	const auto& settings_ = document.GetRoot().AsDict().at("serialization_settings").AsDict();
+	const auto compress = settings_.find("compress"s);
+	return compress != settings_.end() && compress->second.AsBool();
+}
+
+std::optional<std::string> JsonReader::ParseBaseDelta(const json::Document& document) const
 {
-	ParseStops(catalogue, document);
-	ParseStopsLength(catalogue, document);
-	ParseBus(catalogue, document);
+	const auto& settings_ = document.GetRoot().AsDict().at("serialization_settings").AsDict();
+	const auto delta = settings_.find("delta"s);
+	if (delta == settings_.end()) {
+		return std::nullopt;
+	}
+	return delta->second.AsString();
 }
 
-Dict JsonReader::GetBusStats(const json::Dict& stat_request, RequestHandler& request_handler) const
+delta::Changes JsonReader::ParseDeltaRequests(const json::Document& document) const
 {
-	auto bus_stat = request_handler.GetBusStats(stat_request.at("name").AsString());
-	if (bus_stat == nullptr) {
-		Dict dict_node = json::Builder{}.StartDict().Key("request_id"s).Value(stat_request.at("id").AsInt())
-													.Key("error_message"s).Value("not found"s).EndDict().Build().AsDict();
-		return dict_node;
+	delta::Changes changes;
+	const auto& delta_requests_ = document.GetRoot().AsDict().at("delta_requests").AsArray();
+	for (const auto& delta_request : delta_requests_) {
+		const auto& request_ = delta_request.AsDict();
+		const auto& type = request_.at("type").AsString();
+		const auto& name = request_.at("name").AsString();
+		if (type == "Stop") {
+			delta::StopChange& stop = changes.stops.emplace_back();
+			stop.name = name;
+			stop.coordinates = { request_.at("latitude").AsDouble(), request_.at("longitude").AsDouble() };
+			if (const auto road_distances_ = request_.find("road_distances"s); road_distances_ != request_.end()) {
+				for (const auto& [name_second_stop, distance] : road_distances_->second.AsDict()) {
+					stop.road_distances.push_back({ name_second_stop, distance.AsDouble() });
+				}
+			}
+		}
+		else if (type == "Bus") {
+			delta::BusChange& bus = changes.buses.emplace_back();
+			bus.name = name;
+			bus.is_roundtrip = request_.at("is_roundtrip").AsBool();
+			for (const auto& stop_ : request_.at("stops").AsArray()) {
+				bus.stops.push_back(stop_.AsString());
+			}
+		}
+		else if (type == "RemoveStop") {
+			changes.removed_stops.push_back(name);
+		}
+		else if (type == "RemoveBus") {
+			changes.removed_buses.push_back(name);
+		}
+		else {
+			throw std::runtime_error("Unknown delta request type: "s + type);
+		}
 	}
+	return changes;
+}
 
-	Dict dict_node = json::Builder{}.StartDict().Key("curvature"s).Value(static_cast<double>(bus_stat->route_length / bus_stat->route_distance))
-												.Key("request_id"s).Value(stat_request.at("id").AsInt())
-												.Key("route_length"s).Value(static_cast<double>(bus_stat->route_length))
-												.Key("stop_count"s).Value(static_cast<int>(bus_stat->stops_count))
-												.Key("unique_stop_count"s).Value(static_cast<int>(bus_stat->unique_stops_count))
-												.EndDict().Build().AsDict();
-	return dict_node;
+void JsonReader::ApplyOutputSettings(const json::Dict& sections)
+{
+	const auto settings = sections.find("serialization_settings"s);
+	if (settings == sections.end()) {
+		return;
+	}
+	const auto& settings_ = settings->second.AsDict();
+	if (const auto compact = settings_.find("compact_output"s); compact != settings_.end() && compact->second.AsBool()) {
+		print_settings_.compact = true;
+	}
+	if (const auto format = settings_.find("number_format"s); format != settings_.end()) {
+		const auto number_format = json::ParseNumberFormat(format->second.AsString());
+		if (!number_format) {
+			throw std::runtime_error("Unknown number_format: "s + format->second.AsString());
+		}
+		print_settings_.number_format = *number_format;
+	}
+	if (const auto precision = settings_.find("number_precision"s); precision != settings_.end()) {
+		if (precision->second.AsInt() < 0) {
+			throw std::runtime_error("number_precision must not be negative");
+		}
+		print_settings_.precision = precision->second.AsInt();
+	}
 }
 
-Dict JsonReader::GetStopStats(const json::Dict& stat_request, RequestHandler& request_handler) const
+void JsonReader::ReadJSON(trans_ctl::TransportCatalogue& catalogue, const json::Document& document)
 {
-	if (request_handler.GetStop(stat_request.at("name").AsString()) == nullptr) {
-		Dict dict_node = json::Builder{}.StartDict().Key("request_id"s).Value(stat_request.at("id").AsInt())
-													.Key("error_message"s).Value("not found"s)
-													.EndDict().Build().AsDict();
-		return dict_node;
+	BaseRequests pending;
+	const auto& base_requests_ = document.GetRoot().AsDict().at("base_requests").AsArray();
+	for (const auto& base_request : base_requests_) {
+		ParseBaseRequest(catalogue, base_request.AsDict(), pending);
 	}
-	Array stops{};
-	auto stop_stat = request_handler.GetBusesByStop(stat_request.at("name").AsString());
-	if (stop_stat.empty()) {
-		Dict dict_node = json::Builder{}.StartDict().Key("buses"s).Value(stops)
-													.Key("request_id"s).Value(stat_request.at("id").AsInt())
-													.EndDict().Build().AsDict();
-		return dict_node;
+	FinishBaseRequests(catalogue, pending);
+}
+
+json::Document JsonReader::ReadJSON(trans_ctl::TransportCatalogue& catalogue, json::StreamReader& reader)
+{
+	BaseRequests pending;
+	Dict sections;
+	std::string key;
+
+	reader.BeginDict();
+	while (reader.NextKey(key)) {
+		if (key == "base_requests"sv) {
+			if (reader.IsContiguous()) {
+				//the whole input is in memory: the array is parsed on all cores, requests are applied in input order
+				const auto base_requests = reader.ReadCompact(GetParseThreads());
+				for (const auto& base_request : base_requests.GetRoot().AsArray()) {
+					ParseBaseRequest(catalogue, base_request.AsDict(), pending);
+				}
+				continue;
+			}
+			//only one request is materialized at a time
+			reader.BeginArray();
+			while (reader.NextElement()) {
+				ParseBaseRequest(catalogue, reader.ReadNode().AsDict(), pending);
+			}
+		}
+		else {
+			sections[std::move(key)] = reader.ReadNode();
+		}
 	}
+	FinishBaseRequests(catalogue, pending);
 
-	for (const auto& stop : stop_stat) { stops.push_back(stop->name); }
-	Dict dict_node = json::Builder{}.StartDict().Key("buses"s).Value(stops)
-												.Key("request_id"s).Value(stat_request.at("id").AsInt())
-												.EndDict().Build().AsDict();
-	return dict_node;
+	return json::Document{ std::move(sections) };
 }
 
-Dict JsonReader::GetRoute(const json::Dict& stat_request, RequestHandler& request_handler) const
+void JsonReader::WriteNotFound(int request_id, json::Writer& writer) const
 {
-	auto route = request_handler.FindRoute(stat_request.at("from").AsString(), stat_request.at("to").AsString());
+	writer.StartDict().Key("error_message"sv).Value("not found"sv)
+		.Key("request_id"sv).Value(request_id)
+		.EndDict();
+}
 
-	if (!route) {
-		Dict dict_node = json::Builder{}.StartDict()
-			.Key("request_id"s).Value(stat_request.at("id").AsInt())
-			.Key("error_message"s).Value("not found"s)
-			.EndDict().Build().AsDict();
-		return dict_node;
+void JsonReader::WriteBusStats(const StatRequest& request, RequestHandler& request_handler, json::Writer& writer) const
+{
+	if (request.object_id == StatRequest::NOT_FOUND) {
+		WriteNotFound(request.id, writer);
+		return;
 	}
+	const auto* bus_stat = request_handler.GetBusStatsById(request.object_id);
 
-	Array items_;
+	writer.StartDict().Key("curvature"sv).Value(static_cast<double>(bus_stat->route_length / bus_stat->route_distance))
+		.Key("request_id"sv).Value(request.id)
+		.Key("route_length"sv).Value(static_cast<double>(bus_stat->route_length))
+		.Key("stop_count"sv).Value(static_cast<int>(bus_stat->stops_count))
+		.Key("unique_stop_count"sv).Value(static_cast<int>(bus_stat->unique_stops_count))
+		.EndDict();
+}
 
-	auto graph = request_handler.GetGraph();
-	auto edges = route.value().edges;
+void JsonReader::WriteStopStats(const StatRequest& request, RequestHandler& request_handler, json::Writer& writer) const
+{
+	if (request.object_id == StatRequest::NOT_FOUND) {
+		WriteNotFound(request.id, writer);
+		return;
+	}
 
+	writer.StartDict().Key("buses"sv).StartArray();
+	for (uint32_t bus_id : request_handler.GetBusesByStopId(request.object_id)) {
+		writer.Value(request_handler.GetBusById(bus_id).name);
+	}
+	writer.EndArray()
+		.Key("request_id"sv).Value(request.id)
+		.EndDict();
+}
+
+void JsonReader::WriteRoute(const StatRequest& request, RequestHandler& request_handler, json::Writer& writer) const
+{
+	if (request.object_id == StatRequest::NOT_FOUND || request.to_id == StatRequest::NOT_FOUND) {
+		WriteNotFound(request.id, writer);
+		return;
+	}
+	auto route = request_handler.FindRoute(request.object_id, request.to_id);
+	if (!route) {
+		WriteNotFound(request.id, writer);
+		return;
+	}
+
+	const auto& graph = request_handler.GetGraph();
+	const auto& edges = route.value().edges;
+
+	//items are written straight to the output, keys go in the order json::Print sorts them
+	writer.StartDict().Key("items"sv).StartArray();
 	for (const auto& edge_id : edges) {
-		auto [bus_name, stop_name, span_count] = request_handler.GetEdgeInfo(edge_id);
-		if (bus_name == "waiting") {
-			Dict dict_ = json::Builder{}.StartDict().Key("type"s).Value("Wait"s)
-				.Key("stop_name"s).Value(request_handler.GetStop(stop_name)->name)
-				.Key("time"s).Value(graph.GetEdge(edge_id).weight)
-				.EndDict().Build().AsDict();
-			items_.push_back(std::move(dict_));
+		const auto [kind, bus_id, stop_id, span_count] = request_handler.GetEdgeInfo(edge_id);
+		if (kind == transport_router::EdgeKind::WAIT) {
+			writer.StartDict().Key("stop_name"sv).Value(request_handler.GetStopById(stop_id).name)
+				.Key("time"sv).Value(graph.GetEdge(edge_id).weight)
+				.Key("type"sv).Value("Wait"sv)
+				.EndDict();
 		}
 		else {
-			Dict dict_ = json::Builder{}.StartDict().Key("type"s).Value("Bus"s)
-				.Key("bus"s).Value(request_handler.GetBus(bus_name)->name)
-				.Key("span_count"s).Value(span_count)
-				.Key("time"s).Value(graph.GetEdge(edge_id).weight)
-				.EndDict().Build().AsDict();
-			items_.push_back(std::move(dict_));
+			writer.StartDict().Key("bus"sv).Value(request_handler.GetBusById(bus_id).name)
+				.Key("span_count"sv).Value(static_cast<int>(span_count))
+				.Key("time"sv).Value(graph.GetEdge(edge_id).weight)
+				.Key("type"sv).Value("Bus"sv)
+				.EndDict();
 		}
 	}
+	writer.EndArray()
+		.Key("request_id"sv).Value(request.id)
+		.Key("total_time"sv).Value(route.value().weight)
+		.EndDict();
+}
 
-	Dict dict_node = json::Builder{}.StartDict()
-		.Key("request_id"s).Value(stat_request.at("id").AsInt())
-		.Key("total_time").Value(route.value().weight)
-		.Key("items").Value(items_)
-		.EndDict().Build().AsDict();
-	return dict_node;
+void JsonReader::WriteStopsList(int request_id, const std::vector<geo::Neighbor>& neighbors, RequestHandler& request_handler, json::Writer& writer) const
+{
+	writer.StartDict().Key("request_id"sv).Value(request_id)
+		.Key("stops"sv).StartArray();
+	for (const auto& [stop_id, distance] : neighbors) {
+		writer.StartDict().Key("distance"sv).Value(distance)
+			.Key("name"sv).Value(request_handler.GetStopById(stop_id).name)
+			.EndDict();
+	}
+	writer.EndArray().EndDict();
 }
 
-Array JsonReader::GetStats(const json::Document& document, RequestHandler& request_handler) const
+void JsonReader::WriteNearestStops(const StatRequest& request, RequestHandler& request_handler, json::Writer& writer) const
 {
-	Array stats_;
-	const auto& stat_requests_ = document.GetRoot().AsDict().at("stat_requests").AsArray();
-	for (const auto& stat_request : stat_requests_) {
-		if (stat_request.AsDict().at("type").AsString() == "Bus") {
-			stats_.push_back(GetBusStats(stat_request.AsDict(), request_handler));
-		}
-		if (stat_request.AsDict().at("type").AsString() == "Stop") {
-			stats_.push_back(GetStopStats(stat_request.AsDict(), request_handler));
-		}
-		if (stat_request.AsDict().at("type").AsString() == "Map") {
-			stats_.push_back(GetMap(document, request_handler));
-		}
-		if (stat_request.AsDict().at("type").AsString() == "Route") {
-			stats_.push_back(GetRoute(stat_request.AsDict(), request_handler));
-		}
+	auto neighbors = request_handler.GetNearestStops(request.coordinates, request.count);
+	WriteStopsList(request.id, neighbors, request_handler, writer);
+}
+
+void JsonReader::WriteStopsInRadius(const StatRequest& request, RequestHandler& request_handler, json::Writer& writer) const
+{
+	auto neighbors = request_handler.GetStopsInRadius(request.coordinates, request.radius);
+	WriteStopsList(request.id, neighbors, request_handler, writer);
+}
+
+void JsonReader::WriteStopSearch(const StatRequest& request, RequestHandler& request_handler, json::Writer& writer) const
+{
+	auto stop_ids = request_handler.SearchStops(request.text, request.count);
+
+	writer.StartDict().Key("request_id"sv).Value(request.id)
+		.Key("stops"sv).StartArray();
+	for (uint32_t stop_id : stop_ids) {
+		writer.Value(request_handler.GetStopById(stop_id).name);
+	}
+	writer.EndArray().EndDict();
+}
+
+template <typename DictType>
+StatRequest JsonReader::ParseStatRequest(const DictType& stat_request, const RequestHandler& request_handler) const
+{
+	static constexpr std::pair<std::string_view, StatRequest::Type> TYPES[] = {
+		{ "Bus"sv, StatRequest::Type::BUS },
+		{ "Stop"sv, StatRequest::Type::STOP },
+		{ "Map"sv, StatRequest::Type::MAP },
+		{ "Route"sv, StatRequest::Type::ROUTE },
+		{ "NearestStops"sv, StatRequest::Type::NEAREST_STOPS },
+		{ "StopsInRadius"sv, StatRequest::Type::STOPS_IN_RADIUS },
+		{ "StopSearch"sv, StatRequest::Type::STOP_SEARCH },
+	};
+
+	StatRequest request;
+	request.id = stat_request.at("id").AsInt();
+	const auto& type = stat_request.at("type").AsString();
+	const auto it = std::find_if(std::begin(TYPES), std::end(TYPES), [&type](const auto& entry) {
+		return entry.first == type;
+	});
+	if (it == std::end(TYPES)) {
+		request.text = type;
+		return request;
+	}
+	request.type = it->second;
+
+	//non-positive count and limit mean an empty answer
+	auto to_count = [](int value) {
+		return value > 0 ? static_cast<size_t>(value) : 0;
+	};
+
+	switch (request.type) {
+	case StatRequest::Type::BUS:
+		request.object_id = request_handler.FindBusId(stat_request.at("name").AsString());
+		break;
+	case StatRequest::Type::STOP:
+		request.object_id = request_handler.FindStopId(stat_request.at("name").AsString());
+		break;
+	case StatRequest::Type::ROUTE:
+		request.object_id = request_handler.FindStopId(stat_request.at("from").AsString());
+		request.to_id = request_handler.FindStopId(stat_request.at("to").AsString());
+		break;
+	case StatRequest::Type::NEAREST_STOPS:
+		request.coordinates = { stat_request.at("latitude").AsDouble(), stat_request.at("longitude").AsDouble() };
+		request.count = to_count(stat_request.at("count").AsInt());
+		break;
+	case StatRequest::Type::STOPS_IN_RADIUS:
+		request.coordinates = { stat_request.at("latitude").AsDouble(), stat_request.at("longitude").AsDouble() };
+		request.radius = stat_request.at("radius").AsDouble();
+		break;
+	case StatRequest::Type::STOP_SEARCH:
+		request.text = stat_request.at("prefix").AsString();
+		request.count = to_count(stat_request.at("limit").AsInt());
+		break;
+	default:
+		break;
 	}
-	return stats_;
+	return request;
+}
+
+void JsonReader::WriteUnknownRequest(const StatRequest& request, RequestHandler&, json::Writer& writer) const
+{
+	writer.StartDict().Key("error_message"sv).Value("unknown request type '"s + request.text + "'"s)
+		.Key("request_id"sv).Value(request.id)
+		.EndDict();
+}
+
+void JsonReader::WriteStat(const StatRequest& request, RequestHandler& request_handler, json::Writer& writer) const
+{
+	//indexed by StatRequest::Type
+	using StatWriter = void (JsonReader::*)(const StatRequest&, RequestHandler&, json::Writer&) const;
+	static constexpr StatWriter WRITERS[] = {
+		&JsonReader::WriteBusStats,
+		&JsonReader::WriteStopStats,
+		&JsonReader::WriteMap,
+		&JsonReader::WriteRoute,
+		&JsonReader::WriteNearestStops,
+		&JsonReader::WriteStopsInRadius,
+		&JsonReader::WriteStopSearch,
+		&JsonReader::WriteUnknownRequest,
+	};
+	static_assert(std::size(WRITERS) == static_cast<size_t>(StatRequest::Type::UNKNOWN) + 1);
+
+	(this->*WRITERS[static_cast<size_t>(request.type)])(request, request_handler, writer);
+}
+
+template <typename Requests>
+void JsonReader::PrintRequests(const Requests& stat_requests, RequestHandler& request_handler, std::ostream& out) const
+{
+	json::OutputBuffer buffer(out);
+	json::Writer writer(buffer, print_settings_);
+	writer.StartArray();
+	for (const auto& stat_request : stat_requests) {
+		WriteStat(ParseStatRequest(stat_request.AsDict(), request_handler), request_handler, writer);
+	}
+	writer.EndArray().Finish();
 }
 
 void JsonReader::PrintStats(const json::Document& document, RequestHandler& request_handler, std::ostream& out)
 {
-	Document doc(GetStats(document, request_handler));
-	json::Print(doc, out);
+	ApplyOutputSettings(document.GetRoot().AsDict());
+	PrintRequests(document.GetRoot().AsDict().at("stat_requests").AsArray(), request_handler, out);
 }
 
-Dict JsonReader::GetMap(const json::Document& document, RequestHandler& request_handler) const
+void JsonReader::PrintStats(json::StreamReader& reader, const BaseLoader& base, std::ostream& out)
 {
-	int id;
-	const auto& stat_requests_ = document.GetRoot().AsDict().at("stat_requests").AsArray();
-	for (const auto& request : stat_requests_) {
-		if (request.AsDict().at("type").AsString() == "Map") {
-			id = request.AsDict().at("id").AsInt();
+	Dict sections;
+	bool started = false;
+	bool has_requests = false;
+	std::optional<Array> delayed_requests;
+	std::optional<json::CompactDocument> delayed_compact_requests;
+	std::string key;
+
+	auto start = [&]() {
+		ApplyOutputSettings(sections);
+		started = base.start(json::Document{ sections });
+		return started;
+	};
+
+	reader.BeginDict();
+	while (reader.NextKey(key)) {
+		if (key != "stat_requests"sv) {
+			Node section = reader.ReadNode();
+			if (started && key == "serialization_settings"sv) {
+				//the responses are printed already, an output format set after them would be lost
+				for (const auto& name : { "compact_output"s, "number_format"s, "number_precision"s }) {
+					if (section.AsDict().count(name) > 0) {
+						throw std::runtime_error(name + " in serialization_settings must come before stat_requests"s);
+					}
+				}
+			}
+			sections[std::move(key)] = std::move(section);
+			continue;
+		}
+		has_requests = true;
+		if (!started) {
+			start();
+		}
+
+		if (reader.IsContiguous()) {
+			//the whole input is in memory: the array is parsed on all cores while the base loads, answers go in input order
+			auto stat_requests = reader.ReadCompact(GetParseThreads());
+			if (!started) {
+				delayed_compact_requests = std::move(stat_requests);
+			}
+			else {
+				PrintRequests(stat_requests.GetRoot().AsArray(), *base.get(true), out);
+			}
+			continue;
+		}
+		if (!started) {
+			//the base file is not known yet, so the requests have to wait for it
+			delayed_requests = reader.ReadNode().AsArray();
+			continue;
 		}
+
+		//requests read while the base is loading are kept, then the rest is answered as it arrives
+		Array pending;
+		RequestHandler* request_handler = nullptr;
+		json::OutputBuffer buffer(out);
+		json::Writer writer(buffer, print_settings_);
+		auto write_pending = [&]() {
+			for (const auto& stat_request : pending) {
+				WriteStat(ParseStatRequest(stat_request.AsDict(), *request_handler), *request_handler, writer);
+			}
+			Array().swap(pending);
+		};
+		writer.StartArray();
+		reader.BeginArray();
+		while (reader.NextElement()) {
+			Node stat_request = reader.ReadNode();
+			if (request_handler == nullptr && (request_handler = base.get(false)) != nullptr) {
+				write_pending();
+			}
+			if (request_handler == nullptr) {
+				pending.push_back(std::move(stat_request));
+				continue;
+			}
+			WriteStat(ParseStatRequest(stat_request.AsDict(), *request_handler), *request_handler, writer);
+		}
+		if (request_handler == nullptr) {
+			request_handler = base.get(true);
+			write_pending();
+		}
+		writer.EndArray().Finish();
+	}
+
+	if (!has_requests) {
+		throw std::runtime_error("No stat_requests in the input");
 	}
+	if (!delayed_requests && !delayed_compact_requests) {
+		return;
+	}
+	if (!started && !start()) {
+		throw std::runtime_error("The base file is not set: no serialization_settings in the input");
+	}
+	if (delayed_requests) {
+		PrintRequests(*delayed_requests, *base.get(true), out);
+	}
+	else {
+		PrintRequests(delayed_compact_requests->GetRoot().AsArray(), *base.get(true), out);
+	}
+}
 
+void JsonReader::WriteMap(const StatRequest& request, RequestHandler& request_handler, json::Writer& writer) const
+{
 	std::ostringstream oss;
 	request_handler.RenderMap().Render(oss);
-
-	Dict dict_node = json::Builder{}.StartDict().Key("request_id"s).Value(id).Key("map"s).Value(oss.str()).EndDict().Build().AsDict();
-
-	return dict_node;
+	writer.StartDict().Key("map"sv).Value(oss.str())
+		.Key("request_id"sv).Value(request.id)
+		.EndDict();
 }
 
 transport_router::Routing_settings JsonReader::ParseRoutingSettings(const json::Document& document) const
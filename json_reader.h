@@ -1,9 +1,12 @@
 #pragma once
 
+#include "delta.h"
 #include "json_builder.h"
 #include "request_handler.h"
 #include <iostream>
 #include <fstream>
+#include <functional>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -17,23 +20,93 @@ class JsonReader {
 	//cataloque content and statistics
 public:
 	void ReadJSON(trans_ctl::TransportCatalogue& catalogue, const json::Document& document);
-	Array GetStats(const json::Document& document, RequestHandler& request_handler) const;
+	// Потоковое чтение: base_requests передаются в каталог по мере разбора, без построения
+	// дерева всего документа. Остальные разделы возвращаются документом для Parse*Settings
+	json::Document ReadJSON(trans_ctl::TransportCatalogue& catalogue, json::StreamReader& reader);
 	void PrintStats(const json::Document& document, RequestHandler& request_handler, std::ostream& out);
+	// Загрузка базы для потоковой обработки. start получает документ с разделами, прочитанными
+	// до stat_requests, и начинает загрузку в фоне; false - путь к базе ещё неизвестен.
+	// get возвращает обработчик загруженной базы, с wait == false - nullptr, пока база не готова
+	struct BaseLoader {
+		std::function<bool(const json::Document&)> start;
+		std::function<RequestHandler*(bool wait)> get;
+	};
+	// Потоковая обработка: пока база загружается, stat_requests читаются вперёд, затем
+	// выполняются и печатаются по одному. Загрузка начинается, как только становится известен
+	// serialization_settings. Если база уже известна, ответы печатаются сразу, поэтому настройки
+	// вывода в serialization_settings после stat_requests - std::runtime_error
+	void PrintStats(json::StreamReader& reader, const BaseLoader& base, std::ostream& out);
+	// Формат ответов: чисел и отступов, по умолчанию совпадает с json::Print.
+	// Компактный вывод включается ещё и ключом compact_output в serialization_settings,
+	// формат чисел задают ключи number_format ("general", "shortest", "fixed") и number_precision,
+	// они важнее настроек отсюда. Неизвестный формат или отрицательная точность - std::runtime_error
+	void SetPrintSettings(const json::PrintSettings& settings) { print_settings_ = settings; }
 
 private:
-	void ParseStops(trans_ctl::TransportCatalogue& catalogue, const json::Document& document);
-	void ParseStopsLength(trans_ctl::TransportCatalogue& catalogue, const json::Document& document);
-	void ParseBus(trans_ctl::TransportCatalogue& catalogue, const json::Document& document);
+	json::PrintSettings print_settings_;
 
-	Dict GetBusStats(const json::Dict& stat_request, RequestHandler& request_handler) const;
-	Dict GetStopStats(const json::Dict& stat_request, RequestHandler& request_handler) const;
-	Dict GetRoute(const json::Dict& stat_request, RequestHandler& request_handler) const;
+	// Расстояние до остановки, которая ещё не встретилась во входных данных
+	struct PendingDistance {
+		trans_ctl::Stop* from;
+		std::string to;
+		double distance;
+	};
+
+	// Маршрут с остановками, которые ещё не встретились: позиция в списке и имя
+	struct PendingBus {
+		trans_ctl::Bus bus;
+		std::vector<std::pair<size_t, std::string>> unresolved_stops;
+	};
+
+	struct BaseRequests {
+		std::vector<PendingDistance> distances;
+		std::vector<PendingBus> buses;
+	};
+
+	template <typename DictType>
+	void ParseBaseRequest(trans_ctl::TransportCatalogue& catalogue, const DictType& base_request, BaseRequests& pending) const;
+	template <typename DictType>
+	void ParseStop(trans_ctl::TransportCatalogue& catalogue, const DictType& base_request, BaseRequests& pending) const;
+	template <typename DictType>
+	void ParseBus(trans_ctl::TransportCatalogue& catalogue, const DictType& base_request, BaseRequests& pending) const;
+	void FinishBaseRequests(trans_ctl::TransportCatalogue& catalogue, BaseRequests& pending) const;
+
+	// Запросы берутся из json::Array или json::CompactArray, по элементам которых разбираются
+	// шаблонные Parse* ниже: интерфейс чтения у обоих деревьев одинаковый
+	template <typename Requests>
+	void PrintRequests(const Requests& stat_requests, RequestHandler& request_handler, std::ostream& out) const;
+	// Разбирает запрос один раз: тип в перечисление, имена в id базы
+	template <typename DictType>
+	StatRequest ParseStatRequest(const DictType& stat_request, const RequestHandler& request_handler) const;
+	// Ответы пишутся сразу в вывод, ключи каждого словаря - по возрастанию, как их упорядочил бы Dict.
+	// Обработчик выбирается по типу запроса из таблицы
+	void WriteStat(const StatRequest& request, RequestHandler& request_handler, json::Writer& writer) const;
+	void WriteUnknownRequest(const StatRequest& request, RequestHandler& request_handler, json::Writer& writer) const;
+	void WriteNotFound(int request_id, json::Writer& writer) const;
+	void WriteBusStats(const StatRequest& request, RequestHandler& request_handler, json::Writer& writer) const;
+	void WriteStopStats(const StatRequest& request, RequestHandler& request_handler, json::Writer& writer) const;
+	void WriteRoute(const StatRequest& request, RequestHandler& request_handler, json::Writer& writer) const;
+	void WriteNearestStops(const StatRequest& request, RequestHandler& request_handler, json::Writer& writer) const;
+	void WriteStopsInRadius(const StatRequest& request, RequestHandler& request_handler, json::Writer& writer) const;
+	void WriteStopSearch(const StatRequest& request, RequestHandler& request_handler, json::Writer& writer) const;
+	void WriteStopsList(int request_id, const std::vector<geo::Neighbor>& neighbors, RequestHandler& request_handler, json::Writer& writer) const;
 
 	//map 
 public:
 	render::RenderSettings ParseRenderSettings(const json::Document& document) const;
 	std::string ParseSerializationSettings(const json::Document& document);
-	Dict GetMap(const json::Document& document, RequestHandler& request_handler) const;
+	// Формат файла базы из ключа format: "protobuf" (по умолчанию) или "flat"
+	std::string ParseBaseFormat(const json::Document& document) const;
+	// Сжимать ли базу, ключ compress, по умолчанию false
+	bool ParseBaseCompression(const json::Document& document) const;
+	// Файл патча к базе из ключа delta: make_delta пишет его, process_requests применяет к базе
+	std::optional<std::string> ParseBaseDelta(const json::Document& document) const;
+	// Изменения из delta_requests: запросы Stop и Bus в формате base_requests добавляют
+	// или заменяют объект с тем же именем (road_distances у Stop необязательны),
+	// RemoveStop и RemoveBus удаляют объект по name. Запрос другого типа - std::runtime_error
+	delta::Changes ParseDeltaRequests(const json::Document& document) const;
+	void ApplyOutputSettings(const json::Dict& sections);
+	void WriteMap(const StatRequest& request, RequestHandler& request_handler, json::Writer& writer) const;
 
 private:
 	svg::Color ParseColor(const json::Node& color) const;
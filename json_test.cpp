@@ -0,0 +1,122 @@
+#include "json.h"
+#include "json_builder.h"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// Компактный и обычный вывод должны читаться в один и тот же документ:
+// json::Print и json::Writer во всех форматах чисел, на ответе Map со строкой SVG
+// и на вложенных массивах и словарях, в том числе пустых
+
+using namespace std::literals;
+
+namespace {
+
+int failures = 0;
+
+void Check(bool condition, std::string_view what) {
+    if (!condition) {
+        std::cerr << "FAILED: "sv << what << '\n';
+        ++failures;
+    }
+}
+
+const std::string MAP_SVG =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"
+    "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">\n"
+    "  <polyline points=\"99.2283,329.5 50,232.18 99.2283,329.5\" fill=\"none\" stroke=\"green\" stroke-width=\"14\" "
+    "stroke-linecap=\"round\" stroke-linejoin=\"round\"/>\n"
+    "  <text fill=\"rgba(255,255,255,0.85)\" stroke=\"rgba(255,255,255,0.85)\" x=\"99.2283\" y=\"329.5\" dx=\"7\" dy=\"15\" "
+    "font-size=\"20\" font-family=\"Verdana\" font-weight=\"bold\">114</text>\n"
+    "  <text fill=\"black\" x=\"50\" y=\"232.18\" dx=\"7\" dy=\"-3\" font-size=\"20\" font-family=\"Verdana\">"
+    "Улица &quot;Лизы Чайкиной&quot; &amp; \\ \t &lt;Ривьерский мост&gt;</text>\r\n"
+    "</svg>"s;
+
+json::Document MakeMapResponse() {
+    return json::Document{json::Builder{}
+        .StartArray()
+            .StartDict().Key("map"s).Value(MAP_SVG).Key("request_id"s).Value(3).EndDict()
+        .EndArray()
+        .Build()};
+}
+
+json::Document MakeNestedArrays() {
+    return json::Document{json::Builder{}
+        .StartDict()
+            .Key("empty_array"s).StartArray().EndArray()
+            .Key("empty_dict"s).StartDict().EndDict()
+            .Key("items"s).StartArray()
+                .StartArray().StartArray().StartArray().EndArray().EndArray().EndArray()
+                .StartArray().Value(1).Value(-2.5).Value(1e-7).Value(123456789.25).Value(true).Value(nullptr).EndArray()
+                .StartArray()
+                    .StartDict().Key("stop_name"s).Value("Stop \"A\"\n"s).Key("time"s).Value(6.125).Key("type"s).Value("Wait"s).EndDict()
+                    .StartDict().Key("bus"s).Value("297"s).Key("span_count"s).Value(2).Key("time"s).Value(1.78).Key("type"s).Value("Bus"s).EndDict()
+                .EndArray()
+            .EndArray()
+            .Key("request_id"s).Value(5)
+            .Key("total_time"s).Value(11.235)
+        .EndDict()
+        .Build()};
+}
+
+std::string PrintToString(const json::Document& document, const json::PrintSettings& settings) {
+    std::ostringstream output;
+    json::Print(document, output, settings);
+    return output.str();
+}
+
+// Тот же документ через потоковую запись, как печатаются ответы на stat_requests
+std::string WriteToString(const json::Document& document, const json::PrintSettings& settings) {
+    std::ostringstream output;
+    {
+        json::OutputBuffer buffer(output);
+        json::Writer writer(buffer, settings);
+        writer.Value(document.GetRoot());
+        writer.Finish();
+    }
+    return output.str();
+}
+
+void CheckCompactMatchesPretty(std::string_view name, const json::Document& document) {
+    const std::pair<std::string_view, json::NumberFormat> formats[] = {
+        {"general"sv, json::NumberFormat::GENERAL},
+        {"shortest"sv, json::NumberFormat::SHORTEST},
+        {"fixed"sv, json::NumberFormat::FIXED},
+    };
+    for (const auto& [format_name, number_format] : formats) {
+        json::PrintSettings pretty;
+        pretty.number_format = number_format;
+        pretty.precision = number_format == json::NumberFormat::FIXED ? 10 : 6;
+        json::PrintSettings compact = pretty;
+        compact.compact = true;
+
+        const std::string what = std::string(name) + ", "s + std::string(format_name);
+        const std::string compact_text = PrintToString(document, compact);
+        const std::string pretty_text = PrintToString(document, pretty);
+        Check(compact_text.size() < pretty_text.size(), what + ": compact output is shorter"s);
+        Check(compact_text.find('\n') == std::string::npos, what + ": compact output has no line breaks"s);
+        Check(json::Load(std::string_view(compact_text)) == json::Load(std::string_view(pretty_text)),
+              what + ": compact and pretty Print load to the same document"s);
+        Check(WriteToString(document, compact) == compact_text, what + ": compact Writer output matches Print"s);
+        Check(WriteToString(document, pretty) == pretty_text, what + ": pretty Writer output matches Print"s);
+
+        if (number_format == json::NumberFormat::SHORTEST) {
+            Check(json::Load(std::string_view(compact_text)) == document, what + ": compact output loads to the original"s);
+        }
+    }
+}
+
+}  // namespace
+
+int main() {
+    CheckCompactMatchesPretty("map response"sv, MakeMapResponse());
+    CheckCompactMatchesPretty("nested arrays"sv, MakeNestedArrays());
+
+    if (failures != 0) {
+        std::cerr << failures << " check(s) failed\n"sv;
+        return 1;
+    }
+    std::cout << "json_test: all checks passed\n"sv;
+    return 0;
+}
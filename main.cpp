@@ -1,70 +1,398 @@
+#include "delta.h"
+#include "flat_base.h"
 #include "json_reader.h"
+#include "mapped_file.h"
 #include "serialization.h"
+#include "task_graph.h"
 
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
 #include <fstream>
+#include <future>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
 #include <string_view>
+#include <thread>
+#include <vector>
 
 using namespace std::literals;
 
-json::Document LoadJSON(std::istream& input) {
-    return json::Load(input);
+// База, загруженная из файла, и построенные по ней объекты для обработки запросов.
+// Файл отображён в память; плоская база используется прямо из отображения,
+// поэтому file и файл патча delta_file объявлены первыми и живут дольше каталога. Распакованные секции сжатой
+// базы хранит десериализатор, он объявлен сразу после file.
+// Визуализатор и маршрутизатор загружаются только при первом запросе Map или Route
+struct TransportBase {
+    template <typename Deserializer>
+    TransportBase(std::unique_ptr<io::MappedFile> base_file, std::unique_ptr<io::MappedFile> base_delta_file,
+                  std::shared_ptr<Deserializer> deserializer)
+        : file(std::move(base_file))
+        , delta_file(std::move(base_delta_file))
+        , deserializer_owner(deserializer)
+        , catalogue(deserializer->DeserializeTransportCatalogue())
+        , request_handler(catalogue,
+              [this, deserializer]() -> const renderer::MapRenderer& {
+                  auto& renderer = map_renderer.emplace(deserializer->DeserializeRenderSettings());
+                  renderer.SetBusesColors(request_handler.GetBusesColors(renderer.GetSettings().color_palette));
+                  return renderer;
+              },
+              [this, deserializer]() -> const transport_router::TRouter& {
+                  auto graph = deserializer->DeserializeGraph();
+                  auto& loaded_router = router.emplace(deserializer->DeserializeRouter(catalogue));
+                  loaded_router.ConnectGraph(graph);
+                  return loaded_router;
+              }) {
+    }
+
+    // Загрузчики ссылаются на this
+    TransportBase(const TransportBase&) = delete;
+    TransportBase& operator=(const TransportBase&) = delete;
+
+    std::unique_ptr<io::MappedFile> file;
+    std::unique_ptr<io::MappedFile> delta_file;
+    std::shared_ptr<void> deserializer_owner;
+    trans_ctl::TransportCatalogue catalogue;
+    std::optional<renderer::MapRenderer> map_renderer;
+    std::optional<transport_router::TRouter> router;
+    RequestHandler request_handler;
+};
+
+// Формат базы определяется по заголовку файла, а не по настройкам запроса.
+// Контрольные суммы проверяют конструкторы десериализаторов, до разбора базы.
+// Патч от make_delta применяется только к плоской базе
+std::unique_ptr<TransportBase> OpenBase(const std::string& path, const std::optional<std::string>& delta_path) {
+    auto file = std::make_unique<io::MappedFile>(path, io::MappedFile::Access::RANDOM);
+    const std::string_view data = file->GetData();
+    if (delta_path) {
+        if (!serialize::flat::IsFlatBase(data)) {
+            throw std::runtime_error("Delta files apply only to flat bases");
+        }
+        auto delta_file = std::make_unique<io::MappedFile>(*delta_path, io::MappedFile::Access::RANDOM);
+        auto deserializer = std::make_shared<serialize::FlatDeserializer>(data, delta_file->GetData());
+        return std::make_unique<TransportBase>(std::move(file), std::move(delta_file), std::move(deserializer));
+    }
+    if (serialize::flat::IsFlatBase(data)) {
+        return std::make_unique<TransportBase>(std::move(file), nullptr, std::make_shared<serialize::FlatDeserializer>(data));
+    }
+    return std::make_unique<TransportBase>(std::move(file), nullptr, std::make_shared<serialize::Deserializer>(data));
+}
+
+// База, которая загружается в фоновом потоке, пока разбираются запросы: отображение файла,
+// проверка контрольных сумм (она же прочитывает файл целиком) и разбор каталога.
+// На одном ядре перекрывать нечего, и база загружается сразу в Start.
+// Маршрутизатор по-прежнему строится при первом запросе Route
+class BackgroundBase {
+public:
+    void Start(std::string path, std::optional<std::string> delta_path) {
+        if (std::thread::hardware_concurrency() <= 1) {
+            const auto start = std::chrono::steady_clock::now();
+            base_ = OpenBase(path, delta_path);
+            load_time_ = std::chrono::steady_clock::now() - start;
+            return;
+        }
+        loading_ = std::async(std::launch::async, [this, path = std::move(path), delta_path = std::move(delta_path)]() {
+            const auto start = std::chrono::steady_clock::now();
+            //the flag is set on failure too, so the error comes out of the next Get
+            try {
+                auto base = OpenBase(path, delta_path);
+                load_time_ = std::chrono::steady_clock::now() - start;
+                ready_ = true;
+                return base;
+            }
+            catch (...) {
+                ready_ = true;
+                throw;
+            }
+        });
+    }
+
+    bool IsStarted() const {
+        return loading_.valid() || base_ != nullptr;
+    }
+
+    // Ошибка загрузки бросается отсюда
+    RequestHandler* Get(bool wait) {
+        if (base_ == nullptr) {
+            //Get is called for every request read ahead, a poll of the future would cost a system call
+            if (!wait && !ready_) {
+                return nullptr;
+            }
+            const auto start = std::chrono::steady_clock::now();
+            base_ = loading_.get();
+            wait_time_ = std::chrono::steady_clock::now() - start;
+        }
+        return &base_->request_handler;
+    }
+
+    // Время загрузки и время, которое обработка запросов ждала базу.
+    // Если базу ни разу не запросили, дожидается окончания загрузки
+    void PrintTimings(std::ostream& stream) const {
+        //load_time_ is written by the loading thread, the wait orders it before the read
+        if (loading_.valid()) {
+            loading_.wait();
+        }
+        stream << "load_base: "sv << load_time_.count() << " ms\n"sv;
+        stream << "wait_for_base: "sv << wait_time_.count() << " ms\n"sv;
+    }
+
+private:
+    std::atomic<bool> ready_ = false;
+    std::future<std::unique_ptr<TransportBase>> loading_;
+    std::unique_ptr<TransportBase> base_;
+    std::chrono::duration<double, std::milli> load_time_{ 0 };
+    std::chrono::duration<double, std::milli> wait_time_{ 0 };
+};
+
+// Собирает базу в формате выбранного сериализатора графом задач на пуле потоков.
+// После заполнения каталога статистика маршрутов, граф маршрутизатора и части базы
+// готовятся независимо. Часть пишется в файл, как только готовы она и все части перед ней,
+// поэтому содержимое файла не зависит от порядка выполнения задач.
+// Таблица кратчайших путей здесь не строится: в базу она не попадает
+template <typename Serializer>
+void MakeBase(Serializer& serializer, trans_ctl::TransportCatalogue& catalogue, const JsonReader& json_reader,
+              const json::Document& doc, std::ostream& output, tasks::TaskGraph& task_graph) {
+    using serialize::BasePart;
+    using TaskId = tasks::TaskGraph::TaskId;
+
+    transport_router::TRouter router(json_reader.ParseRoutingSettings(doc), catalogue);
+
+    // the longest chain is added first, so it starts right away
+    const TaskId build_graph = task_graph.Add("build_graph", {}, [&]() { router.BuildGraph(); });
+    const TaskId bus_stats = task_graph.Add("bus_stats", {}, [&]() { catalogue.CalcAllBusStats(); });
+
+    struct Part {
+        BasePart id;
+        std::string name;
+        TaskId task;
+    };
+    // in the order of BasePart
+    const std::vector<Part> parts = {
+        { BasePart::STOPS, "stops", task_graph.Add("serialize_stops", {}, [&]() { serializer.SerializeStops(); }) },
+        { BasePart::STOP_DISTANCES, "stop_distances", task_graph.Add("serialize_stop_distances", {}, [&]() { serializer.SerializeStopDistances(); }) },
+        { BasePart::BUSES, "buses", task_graph.Add("serialize_buses", { bus_stats }, [&]() { serializer.SerializeBusses(); }) },
+        { BasePart::RENDER_SETTINGS, "render_settings", task_graph.Add("serialize_render_settings", {}, [&]() { serializer.SerializeRenderSettings(json_reader, doc); }) },
+        { BasePart::ROUTING_SETTINGS, "routing_settings", task_graph.Add("serialize_routing_settings", {}, [&]() { serializer.SerializeRouterSettings(json_reader, doc); }) },
+        { BasePart::GRAPH, "graph", task_graph.Add("serialize_graph", { build_graph }, [&]() { serializer.SerializeGraph(router.GetGraph()); }) },
+        { BasePart::ROUTER, "router", task_graph.Add("serialize_router", { build_graph }, [&]() { serializer.SerializeRouter(router); }) },
+    };
+
+    std::optional<TaskId> previous_write;
+    for (const auto& part : parts) {
+        std::vector<TaskId> dependencies = { part.task };
+        if (previous_write) {
+            dependencies.push_back(*previous_write);
+        }
+        previous_write = task_graph.Add("write_" + part.name, std::move(dependencies),
+            [&serializer, &output, id = part.id]() { serializer.WritePart(id, output); });
+    }
+    task_graph.Add("finish_write", { *previous_write }, [&]() { serializer.FinishWrite(output); });
+
+    task_graph.Run(std::max(1u, std::thread::hardware_concurrency()));
 }
 
 void PrintUsage(std::ostream& stream = std::cerr) {
-    stream << "Usage: transport_catalogue [make_base|process_requests]\n"sv;
+    stream << "Usage: transport_catalogue [make_base|make_delta|process_requests] [--input <file>] [--base <file> [--delta <file>]] [--compact] "
+              "[--number-format general|shortest|fixed] [--precision <digits>] [--timings]\n"sv;
 }
 
+// Источник входного JSON: файл из --input, отображённый в память, или stdin.
+// Разбор из отображения идёт прямо по его байтам, без копии в буферы потока
+struct Input {
+    explicit Input(const std::optional<std::string>& path) {
+        if (path) {
+            file.emplace(*path);
+            reader = std::make_unique<json::StreamReader>(file->GetData());
+        }
+        else {
+            reader = std::make_unique<json::StreamReader>(std::cin);
+        }
+    }
+
+    std::optional<io::MappedFile> file;
+    std::unique_ptr<json::StreamReader> reader;
+};
+
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
+    if (argc < 2) {
         PrintUsage();
         return 1;
     }
 
     const std::string_view mode(argv[1]);
+    std::optional<std::string> input_path;
+    // База для process_requests вместо serialization_settings: загрузка начинается до чтения входа
+    std::optional<std::string> base_path;
+    std::optional<std::string> base_delta_path;
+    json::PrintSettings print_settings;
+    bool print_timings = false;
+    for (int i = 2; i < argc; ++i) {
+        if (argv[i] == "--input"sv && i + 1 < argc) {
+            input_path = argv[++i];
+        }
+        else if (argv[i] == "--base"sv && i + 1 < argc) {
+            base_path = argv[++i];
+        }
+        else if (argv[i] == "--delta"sv && i + 1 < argc) {
+            base_delta_path = argv[++i];
+        }
+        else if (argv[i] == "--compact"sv) {
+            print_settings.compact = true;
+        }
+        else if (argv[i] == "--number-format"sv && i + 1 < argc) {
+            const auto number_format = json::ParseNumberFormat(argv[++i]);
+            if (!number_format) {
+                PrintUsage();
+                return 1;
+            }
+            print_settings.number_format = *number_format;
+        }
+        else if (argv[i] == "--precision"sv && i + 1 < argc) {
+            const std::string_view digits(argv[++i]);
+            const auto result = std::from_chars(digits.data(), digits.data() + digits.size(), print_settings.precision);
+            if (result.ec != std::errc{} || result.ptr != digits.data() + digits.size() || print_settings.precision < 0) {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (argv[i] == "--timings"sv) {
+            print_timings = true;
+        }
+        else {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if (base_delta_path && !base_path) {
+        PrintUsage();
+        return 1;
+    }
 
     if (mode == "make_base"sv) {
 
-        trans_ctl::TransportCatalogue catalogue;
-        auto doc = LoadJSON(std::cin);
-        JsonReader json_reader;
-        json_reader.ReadJSON(catalogue, doc);
+        try {
+            trans_ctl::TransportCatalogue catalogue;
+            JsonReader json_reader;
+            const auto read_start = std::chrono::steady_clock::now();
+            Input input(input_path);
+            auto doc = json_reader.ReadJSON(catalogue, *input.reader);
+            const std::chrono::duration<double, std::milli> read_time = std::chrono::steady_clock::now() - read_start;
 
-        std::string filename = json_reader.ParseSerializationSettings(doc);
-        std::ofstream ostrm(filename, std::ios::binary);
-        serialize::Serializer serializer(catalogue);
-        serializer.SerializeTransportCatalogue();
-        serializer.SerializeRenderSettings(json_reader, doc);
-        serializer.SerializeRouterSettings(json_reader, doc);
+            std::string filename = json_reader.ParseSerializationSettings(doc);
+            const std::string format = json_reader.ParseBaseFormat(doc);
+            if (format != "protobuf"sv && format != "flat"sv) {
+                std::cerr << "Unknown base format: "sv << format << '\n';
+                return 1;
+            }
+            const bool compress = json_reader.ParseBaseCompression(doc);
+            if (compress && format != "flat"sv) {
+                std::cerr << "Compression is supported only for the flat base format\n"sv;
+                return 1;
+            }
+            std::ofstream ostrm(filename, std::ios::binary);
+            tasks::TaskGraph task_graph;
+            if (format == "flat"sv) {
+                serialize::FlatSerializer serializer(catalogue, compress);
+                MakeBase(serializer, catalogue, json_reader, doc, ostrm, task_graph);
+            }
+            else {
+                serialize::Serializer serializer(catalogue);
+                MakeBase(serializer, catalogue, json_reader, doc, ostrm, task_graph);
+            }
 
-        transport_router::TRouter router(json_reader.ParseRoutingSettings(doc), catalogue);
-        router.Build();
-        serializer.SerializeGraph(router.GetGraph());
-        serializer.SerializeRouter(router);
+            if (print_timings) {
+                std::cerr << "read_json: "sv << read_time.count() << " ms\n"sv;
+                task_graph.PrintTimings(std::cerr);
+            }
+        }
+        catch (const std::exception& error) {
+            std::cerr << "make_base failed: "sv << error.what() << '\n';
+            return 1;
+        }
+    }
+    else if (mode == "make_delta"sv) {
 
-        serializer.SaveTo(ostrm);
+        try {
+            JsonReader json_reader;
+            const auto start = std::chrono::steady_clock::now();
+            Input input(input_path);
+            const json::Document doc{ input.reader->ReadNode() };
+            const auto delta_path = json_reader.ParseBaseDelta(doc);
+            if (!delta_path) {
+                std::cerr << "make_delta needs the delta file in serialization_settings\n"sv;
+                return 1;
+            }
 
+            io::MappedFile base_file(json_reader.ParseSerializationSettings(doc), io::MappedFile::Access::RANDOM);
+            if (!serialize::flat::IsFlatBase(base_file.GetData())) {
+                std::cerr << "make_delta supports only flat bases\n"sv;
+                return 1;
+            }
+            serialize::FlatDeserializer base(base_file.GetData());
+            //the previous delta is replaced only by a complete one
+            const std::string temporary_path = *delta_path + ".tmp"s;
+            std::ofstream ostrm(temporary_path, std::ios::binary);
+            delta::DeltaStats stats;
+            try {
+                stats = delta::WriteDelta(base, json_reader.ParseDeltaRequests(doc), json_reader.ParseBaseCompression(doc), ostrm);
+                ostrm.close();
+                if (!ostrm || std::rename(temporary_path.c_str(), delta_path->c_str()) != 0) {
+                    throw std::runtime_error("Cannot write "s + *delta_path);
+                }
+            }
+            catch (...) {
+                std::remove(temporary_path.c_str());
+                throw;
+            }
+
+            if (print_timings) {
+                const std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+                std::cerr << "make_delta: "sv << time.count() << " ms, rebuilt "sv << stats.rebuilt_buses
+                          << " of "sv << stats.buses_count << " buses\n"sv;
+            }
+        }
+        catch (const std::exception& error) {
+            std::cerr << "make_delta failed: "sv << error.what() << '\n';
+            return 1;
+        }
     }
     else if (mode == "process_requests"sv) {
 
-        auto doc = LoadJSON(std::cin);
         JsonReader json_reader;
-        std::string filename = json_reader.ParseSerializationSettings(doc);
-        std::ifstream istrm(filename, std::ios::binary);
-        serialize::Deserializer deserializer;
-        trans_ctl::TransportCatalogue catalogue = deserializer.DeserializeTransportCatalogue(istrm);
-
-        renderer::MapRenderer map_renderer(deserializer.DeserializeRenderSettings());
-
-        graph::DirectedWeightedGraph graph = deserializer.DeserializeGraph();
-        transport_router::TRouter router(deserializer.DeserializeRouter(catalogue));
-        router.ConnectGraph(graph);
-
-        RequestHandler request_handler(catalogue, map_renderer, router);
+        json_reader.SetPrintSettings(print_settings);
+        BackgroundBase base;
 
-        map_renderer.SetBusesColors(request_handler.GetBusesColors());
-        
-        json_reader.PrintStats(doc, request_handler, std::cout);
+        //a damaged or stale base is refused with a message instead of a crash
+        try {
+            //a base given on the command line starts loading before the input is read
+            if (base_path) {
+                base.Start(*base_path, base_delta_path);
+            }
+            Input input(input_path);
+            JsonReader::BaseLoader loader;
+            loader.start = [&](const json::Document& settings) {
+                if (!base.IsStarted() && settings.GetRoot().AsDict().count("serialization_settings"s) != 0) {
+                    base.Start(json_reader.ParseSerializationSettings(settings), json_reader.ParseBaseDelta(settings));
+                }
+                return base.IsStarted();
+            };
+            loader.get = [&](bool wait) { return base.Get(wait); };
+            json_reader.PrintStats(*input.reader, loader, std::cout);
+        }
+        catch (const std::exception& error) {
+            std::cout.flush();
+            std::cerr << "process_requests failed: "sv << error.what() << '\n';
+            return 1;
+        }
+        if (print_timings) {
+            base.PrintTimings(std::cerr);
+        }
     }
     else {
         PrintUsage();
@@ -23,7 +23,7 @@ namespace renderer {
     }
 
     void MapRenderer::SetBusesColors(std::map<trans_ctl::Bus*, svg::Color, trans_ctl::BusCmp> colors_map) {
-        buses_colors_ = colors_map;
+        buses_colors_ = std::move(colors_map);
 
         for (const auto& [bus_ptr, color] : buses_colors_) {
             for (const auto& stop : bus_ptr->stops) {
@@ -20,9 +20,9 @@ namespace renderer {
     public:
         MapRenderer(render::RenderSettings render_settings) : render_settings_(render_settings) {}
 
-        render::RenderSettings GetSettings() const { return render_settings_; }
+        const render::RenderSettings& GetSettings() const { return render_settings_; }
 
-        void SetBusesColors(std::map<trans_ctl::Bus*, svg::Color, trans_ctl::BusCmp> colors_map); 
+        void SetBusesColors(std::map<trans_ctl::Bus*, svg::Color, trans_ctl::BusCmp> colors_map);
 
         SphereProjector CalcSphereProjector() const;
         void RenderLines(SphereProjector& proj, svg::Document& doc) const;
@@ -0,0 +1,63 @@
+#include "mapped_file.h"
+
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define TC_HAS_MMAP 1
+#endif
+
+using namespace std::literals;
+
+namespace io {
+
+	MappedFile::MappedFile(const std::string& path, Access access) {
+#ifdef TC_HAS_MMAP
+		const int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			throw std::runtime_error("Cannot open "s + path);
+		}
+		struct stat info {};
+		if (::fstat(fd, &info) != 0) {
+			::close(fd);
+			throw std::runtime_error("Cannot stat "s + path);
+		}
+		size_ = static_cast<size_t>(info.st_size);
+		//an empty file cannot be mapped, it is simply empty data
+		if (size_ != 0) {
+			void* data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data == MAP_FAILED) {
+				::close(fd);
+				throw std::runtime_error("Cannot map "s + path);
+			}
+			::madvise(data, size_, access == Access::SEQUENTIAL ? MADV_SEQUENTIAL : MADV_RANDOM);
+			data_ = static_cast<const char*>(data);
+			mapped_ = true;
+		}
+		//the mapping stays valid after the descriptor is closed
+		::close(fd);
+#else
+		static_cast<void>(access);
+		std::ifstream input(path, std::ios::binary);
+		if (!input) {
+			throw std::runtime_error("Cannot open "s + path);
+		}
+		fallback_.assign(std::istreambuf_iterator<char>(input), {});
+		data_ = fallback_.data();
+		size_ = fallback_.size();
+#endif
+	}
+
+	MappedFile::~MappedFile() {
+#ifdef TC_HAS_MMAP
+		if (mapped_) {
+			::munmap(const_cast<char*>(data_), size_);
+		}
+#endif
+	}
+}
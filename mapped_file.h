@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace io {
+
+	// Файл, отображённый в память только для чтения. Содержимое доступно как string_view
+	// без копирования, пока объект жив. Подсказка ядру о порядке чтения задаётся access:
+	// входной JSON читается один раз от начала до конца, файл базы - вразброс по секциям.
+	// Там, где mmap недоступен, файл целиком читается в память
+	class MappedFile {
+	public:
+		enum class Access {
+			SEQUENTIAL,
+			RANDOM,
+		};
+
+		// Бросает std::runtime_error, если файл не удалось открыть или отобразить
+		explicit MappedFile(const std::string& path, Access access = Access::SEQUENTIAL);
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		~MappedFile();
+
+		std::string_view GetData() const { return { data_, size_ }; }
+
+	private:
+		const char* data_ = nullptr;
+		size_t size_ = 0;
+		bool mapped_ = false;
+		std::string fallback_;
+	};
+}
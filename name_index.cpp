@@ -0,0 +1,244 @@
+#include "name_index.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace trans_ctl {
+
+	namespace {
+		constexpr size_t HEADER_SIZE = 3;
+
+		void WriteUint32(std::string& out, uint32_t value) {
+			char bytes[sizeof(value)];
+			std::memcpy(bytes, &value, sizeof(value));
+			out.append(bytes, sizeof(value));
+		}
+
+		void WriteVarint(std::string& out, uint32_t value) {
+			while (value >= 0x80) {
+				out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+				value >>= 7;
+			}
+			out.push_back(static_cast<char>(value));
+		}
+
+		uint32_t ReadVarint(std::string_view data, size_t& pos) {
+			uint32_t value = 0;
+			for (int shift = 0; pos < data.size(); shift += 7) {
+				const auto byte = static_cast<uint8_t>(data[pos++]);
+				value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+				if ((byte & 0x80) == 0) {
+					break;
+				}
+			}
+			return value;
+		}
+
+		size_t CommonPrefix(std::string_view lhs, std::string_view rhs) {
+			const size_t size = std::min(lhs.size(), rhs.size());
+			size_t i = 0;
+			while (i < size && lhs[i] == rhs[i]) {
+				++i;
+			}
+			return i;
+		}
+
+		bool StartsWith(std::string_view str, std::string_view prefix) {
+			return str.substr(0, prefix.size()) == prefix;
+		}
+	}
+
+	void NameIndex::Build(std::vector<std::pair<std::string_view, uint32_t>> names) {
+		std::sort(names.begin(), names.end());
+
+		const auto count = static_cast<uint32_t>(names.size());
+		const uint32_t block_count = (count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+		std::string strings;
+		std::vector<uint32_t> block_offsets;
+		block_offsets.reserve(block_count);
+		for (uint32_t i = 0; i < count; ++i) {
+			const std::string_view name = names[i].first;
+			if (i % BLOCK_SIZE == 0) {
+				block_offsets.push_back(static_cast<uint32_t>(strings.size()));
+				WriteVarint(strings, static_cast<uint32_t>(name.size()));
+				strings.append(name);
+			}
+			else {
+				const size_t prefix = CommonPrefix(names[i - 1].first, name);
+				WriteVarint(strings, static_cast<uint32_t>(prefix));
+				WriteVarint(strings, static_cast<uint32_t>(name.size() - prefix));
+				strings.append(name.substr(prefix));
+			}
+		}
+
+		std::string data;
+		data.reserve((HEADER_SIZE + block_count + count) * sizeof(uint32_t) + strings.size());
+		WriteUint32(data, count);
+		WriteUint32(data, BLOCK_SIZE);
+		WriteUint32(data, block_count);
+		for (uint32_t offset : block_offsets) {
+			WriteUint32(data, offset);
+		}
+		for (const auto& [name, id] : names) {
+			WriteUint32(data, id);
+		}
+		data += strings;
+
+		Assign(std::move(data));
+	}
+
+	void NameIndex::Assign(std::string data) {
+		owned_ = std::move(data);
+		view_ = {};
+		owns_data_ = true;
+	}
+
+	void NameIndex::View(std::string_view data) {
+		owned_.clear();
+		view_ = data;
+		owns_data_ = false;
+	}
+
+	uint32_t NameIndex::ReadHeader(size_t index) const {
+		uint32_t value;
+		std::memcpy(&value, GetData().data() + index * sizeof(value), sizeof(value));
+		return value;
+	}
+
+	uint32_t NameIndex::GetCount() const {
+		return IsBuilt() ? ReadHeader(0) : 0;
+	}
+
+	uint32_t NameIndex::GetBlockCount() const {
+		return ReadHeader(2);
+	}
+
+	uint32_t NameIndex::GetId(size_t position) const {
+		return ReadHeader(HEADER_SIZE + GetBlockCount() + position);
+	}
+
+	size_t NameIndex::GetStringsOffset() const {
+		return (HEADER_SIZE + GetBlockCount() + GetCount()) * sizeof(uint32_t);
+	}
+
+	std::string_view NameIndex::GetBlockHead(uint32_t block, size_t* next_offset) const {
+		size_t pos = GetStringsOffset() + ReadHeader(HEADER_SIZE + block);
+		const uint32_t size = ReadVarint(GetData(), pos);
+		*next_offset = pos + size;
+		return GetData().substr(pos, size);
+	}
+
+	size_t NameIndex::FindBlock(std::string_view name) const {
+		//the last block whose first name is not greater than name
+		size_t lo = 0;
+		size_t hi = GetBlockCount();
+		while (lo < hi) {
+			const size_t mid = lo + (hi - lo) / 2;
+			size_t next_offset;
+			if (GetBlockHead(static_cast<uint32_t>(mid), &next_offset) <= name) {
+				lo = mid + 1;
+			}
+			else {
+				hi = mid;
+			}
+		}
+		return lo;
+	}
+
+	std::optional<uint32_t> NameIndex::Find(std::string_view name) const {
+		if (GetCount() == 0) {
+			return std::nullopt;
+		}
+		const size_t block_end = FindBlock(name);
+		if (block_end == 0) {
+			return std::nullopt;
+		}
+		const auto block = static_cast<uint32_t>(block_end - 1);
+
+		size_t pos;
+		const std::string_view head = GetBlockHead(block, &pos);
+		//names are not rebuilt: matched is the length of the common prefix of the previous name and name
+		size_t matched = 0;
+		const size_t first = static_cast<size_t>(block) * BLOCK_SIZE;
+		const size_t last = std::min<size_t>(first + BLOCK_SIZE, GetCount());
+		for (size_t position = first; position < last; ++position) {
+			size_t prefix = 0;
+			std::string_view suffix = head;
+			if (position != first) {
+				prefix = ReadVarint(GetData(), pos);
+				const uint32_t suffix_size = ReadVarint(GetData(), pos);
+				suffix = GetData().substr(pos, suffix_size);
+				pos += suffix_size;
+				if (prefix > matched) {
+					//the name keeps the first mismatch of the previous one, so it is still less than name
+					continue;
+				}
+			}
+			const std::string_view rest = name.substr(prefix);
+			if (suffix == rest) {
+				return GetId(position);
+			}
+			if (suffix > rest) {
+				break;
+			}
+			matched = prefix + CommonPrefix(suffix, rest);
+		}
+		return std::nullopt;
+	}
+
+	std::vector<uint32_t> NameIndex::FindByPrefix(std::string_view prefix, size_t limit) const {
+		std::vector<uint32_t> result;
+		if (GetCount() == 0 || limit == 0) {
+			return result;
+		}
+		const size_t block_end = FindBlock(prefix);
+		const auto block = static_cast<uint32_t>(block_end == 0 ? 0 : block_end - 1);
+
+		size_t pos = 0;
+		std::string current;
+		const size_t count = GetCount();
+		for (size_t position = static_cast<size_t>(block) * BLOCK_SIZE; position < count; ++position) {
+			if (position % BLOCK_SIZE == 0) {
+				current = GetBlockHead(static_cast<uint32_t>(position / BLOCK_SIZE), &pos);
+			}
+			else {
+				const uint32_t common = ReadVarint(GetData(), pos);
+				const uint32_t suffix = ReadVarint(GetData(), pos);
+				current.resize(common);
+				current.append(GetData().substr(pos, suffix));
+				pos += suffix;
+			}
+
+			if (StartsWith(current, prefix)) {
+				result.push_back(GetId(position));
+				if (result.size() == limit) {
+					break;
+				}
+			}
+			else if (std::string_view(current) > prefix) {
+				break;
+			}
+		}
+		return result;
+	}
+
+	void NameIndex::ForEach(const std::function<void(std::string_view, uint32_t)>& callback) const {
+		size_t pos = 0;
+		std::string current;
+		const size_t count = GetCount();
+		for (size_t position = 0; position < count; ++position) {
+			if (position % BLOCK_SIZE == 0) {
+				current = GetBlockHead(static_cast<uint32_t>(position / BLOCK_SIZE), &pos);
+			}
+			else {
+				const uint32_t common = ReadVarint(GetData(), pos);
+				const uint32_t suffix = ReadVarint(GetData(), pos);
+				current.resize(common);
+				current.append(GetData().substr(pos, suffix));
+				pos += suffix;
+			}
+			callback(current, GetId(position));
+		}
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace trans_ctl {
+
+	// Неизменяемый индекс имён: отсортированная таблица строк с фронтальным сжатием.
+	// Весь индекс - один непрерывный блок байт без указателей, поэтому его можно
+	// сохранить в файл базы как есть и использовать прямо из отображённой в память области.
+	//
+	// Формат блока (все числа uint32 little-endian):
+	//   count, block_size, block_count
+	//   block_offsets[block_count] - смещения блоков относительно начала таблицы строк
+	//   ids[count]                 - id имён в порядке сортировки
+	//   таблица строк: в каждом блоке первое имя хранится целиком (varint длины + байты),
+	//   остальные - как varint длины общего префикса с предыдущим, varint длины суффикса и суффикс
+	class NameIndex {
+	public:
+		static constexpr uint32_t BLOCK_SIZE = 16;
+
+		void Build(std::vector<std::pair<std::string_view, uint32_t>> names);
+		// Принимает владение готовым блоком индекса
+		void Assign(std::string data);
+		// Использует внешний блок индекса без копирования, память должна жить дольше индекса
+		void View(std::string_view data);
+
+		bool IsBuilt() const { return !GetData().empty(); }
+		std::string_view GetData() const { return owns_data_ ? std::string_view(owned_) : view_; }
+		uint32_t GetCount() const;
+
+		std::optional<uint32_t> Find(std::string_view name) const;
+		// id имён, начинающихся с prefix, в порядке сортировки, не больше limit штук
+		std::vector<uint32_t> FindByPrefix(std::string_view prefix, size_t limit) const;
+		// Вызывает callback(имя, id) для всех имён в порядке сортировки
+		void ForEach(const std::function<void(std::string_view, uint32_t)>& callback) const;
+
+	private:
+		// Вид на данные не храним для собственного блока: при перемещении индекса
+		// короткая строка переезжает вместе с объектом
+		bool owns_data_ = false;
+		std::string owned_;
+		std::string_view view_;
+
+		uint32_t ReadHeader(size_t index) const;
+		uint32_t GetBlockCount() const;
+		uint32_t GetId(size_t position) const;
+		std::string_view GetBlockHead(uint32_t block, size_t* next_offset) const;
+		size_t GetStringsOffset() const;
+		size_t FindBlock(std::string_view name) const;
+	};
+}
@@ -5,32 +5,27 @@ trans_ctl::Bus* RequestHandler::GetBus(const std::string_view& bus_name) const
 	return db_.FindBus(bus_name);
 }
 
-std::unordered_map<std::string_view, trans_ctl::Bus*> RequestHandler::GetAllBuses() const
-{
-	return db_.GetAllRoutes();
-}
-
 trans_ctl::BusStat* RequestHandler::GetBusStats(const std::string_view& bus_name)
 {
 	return db_.ExecuteBusRequest(GetBus(bus_name));
 }
 
-std::map<trans_ctl::Bus*, svg::Color, trans_ctl::BusCmp> RequestHandler::GetBusesColors()
+std::map<trans_ctl::Bus*, svg::Color, trans_ctl::BusCmp> RequestHandler::GetBusesColors(const std::vector<svg::Color>& color_palette) const
 {
 	std::map<trans_ctl::Bus*, svg::Color, trans_ctl::BusCmp> map_;
 
-	const auto& buses_map = GetAllBuses();
-	for (const auto& [bus_name, bus_ptr] : buses_map) {
+	for (const auto& bus : db_.GetBuses()) {
+		trans_ctl::Bus* bus_ptr = const_cast<trans_ctl::Bus*>(&bus);
 		if (!db_.BusIsEmpty(bus_ptr)) {
 			map_[bus_ptr];
 		}
 	}
 
 	size_t i = 0;
-	size_t colors_count = GetRenderSettings().color_palette.size();
+	size_t colors_count = color_palette.size();
 	for (auto& [bus, color] : map_) {
 		if (i > colors_count - 1) { i = 0; }
-		map_[bus] = GetRenderSettings().color_palette[i];
+		color = color_palette[i];
 		++i;
 	}
 
@@ -42,33 +37,101 @@ trans_ctl::Stop* RequestHandler::GetStop(const std::string_view& stop_name) cons
 	return db_.FindStop(stop_name);
 }
 
-const std::set<trans_ctl::Bus*, trans_ctl::BusCmp> RequestHandler::GetBusesByStop(const std::string_view& stop_name) const
+uint32_t RequestHandler::FindStopId(std::string_view stop_name) const
+{
+	const trans_ctl::Stop* stop = db_.FindStop(stop_name);
+	return stop != nullptr ? stop->id : StatRequest::NOT_FOUND;
+}
+
+uint32_t RequestHandler::FindBusId(std::string_view bus_name) const
+{
+	const trans_ctl::Bus* bus = db_.FindBus(bus_name);
+	return bus != nullptr ? bus->id : StatRequest::NOT_FOUND;
+}
+
+trans_ctl::BusStat* RequestHandler::GetBusStatsById(uint32_t bus_id)
+{
+	return db_.ExecuteBusRequest(const_cast<trans_ctl::Bus*>(&db_.GetBusById(bus_id)));
+}
+
+const trans_ctl::Bus& RequestHandler::GetBusById(uint32_t id) const
+{
+	return db_.GetBusById(id);
+}
+
+trans_ctl::BusIdsRange RequestHandler::GetBusesByStop(const std::string_view& stop_name) const
 {
 	return db_.ExecuteStopRequest(db_.FindStop(stop_name));
 }
 
-const render::RenderSettings RequestHandler::GetRenderSettings() const
+trans_ctl::BusIdsRange RequestHandler::GetBusesByStopId(uint32_t stop_id) const
+{
+	return db_.GetStopBuses(stop_id);
+}
+
+const trans_ctl::Stop& RequestHandler::GetStopById(uint32_t id) const
+{
+	return db_.GetStopById(id);
+}
+
+std::vector<uint32_t> RequestHandler::SearchStops(std::string_view prefix, size_t limit) const
 {
-	return renderer_.GetSettings();
+	return db_.FindStopsByPrefix(prefix, limit);
+}
+
+std::vector<geo::Neighbor> RequestHandler::GetNearestStops(geo::Coordinates coordinates, size_t count) const
+{
+	return db_.FindNearestStops(coordinates, count);
+}
+
+std::vector<geo::Neighbor> RequestHandler::GetStopsInRadius(geo::Coordinates coordinates, double radius) const
+{
+	return db_.FindStopsInRadius(coordinates, radius);
+}
+
+const render::RenderSettings& RequestHandler::GetRenderSettings() const
+{
+	return GetRenderer().GetSettings();
 }
 
 svg::Document RequestHandler::RenderMap()
 {
-	return renderer_.Render();
+	return GetRenderer().Render();
 }
 
 std::optional<graph::Router<double>::RouteInfo> RequestHandler::FindRoute(const std::string_view& from, const std::string_view& to) const
 {
-	return router_.BuildRoute(from, to);
+	return GetRouter().BuildRoute(from, to);
+}
+
+std::optional<graph::Router<double>::RouteInfo> RequestHandler::FindRoute(uint32_t from_id, uint32_t to_id) const
+{
+	return GetRouter().BuildRoute(from_id, to_id);
+}
+
+const graph::DirectedWeightedGraph<double>& RequestHandler::GetGraph() const
+{
+	return GetRouter().GetGraph();
 }
 
-graph::DirectedWeightedGraph<double> RequestHandler::GetGraph() const
+transport_router::EdgeInfo RequestHandler::GetEdgeInfo(size_t id) const
 {
-	return router_.GetGraph();
+	return GetRouter().GetEdgeInfo(id);
 }
 
-transport_router::EdgeIdtoBus RequestHandler::GetEdgeInfo(size_t id) const
+
+const renderer::MapRenderer& RequestHandler::GetRenderer() const
 {
-	return router_.GetEdgeInfo(id);
+	if (renderer_ == nullptr) {
+		renderer_ = &load_renderer_();
+	}
+	return *renderer_;
 }
 
+const transport_router::TRouter& RequestHandler::GetRouter() const
+{
+	if (router_ == nullptr) {
+		router_ = &load_router_();
+	}
+	return *router_;
+}
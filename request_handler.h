@@ -4,43 +4,110 @@
 #include "map_renderer.h"
 #include "transport_router.h"
 
+#include <functional>
+
+// Запрос из stat_requests, разобранный один раз: тип - перечисление, имена остановок
+// и маршрутов уже заменены на их id в базе
+struct StatRequest {
+    enum class Type : uint8_t {
+        BUS,
+        STOP,
+        MAP,
+        ROUTE,
+        NEAREST_STOPS,
+        STOPS_IN_RADIUS,
+        STOP_SEARCH,
+        UNKNOWN,
+    };
+
+    // id имени, которого нет в базе
+    static constexpr uint32_t NOT_FOUND = UINT32_MAX;
+
+    Type type = Type::UNKNOWN;
+    int id = 0;
+    // Bus - маршрут, Stop - остановка, Route - остановка отправления
+    uint32_t object_id = NOT_FOUND;
+    // Route - остановка назначения
+    uint32_t to_id = NOT_FOUND;
+    // NearestStops, StopsInRadius
+    geo::Coordinates coordinates{};
+    double radius = 0.0;
+    // NearestStops - count, StopSearch - limit
+    size_t count = 0;
+    // StopSearch - префикс, для неизвестного типа - сам тип
+    std::string text;
+};
+
 class RequestHandler {
 public:
+    // Загрузчики визуализатора и маршрутизатора вызываются при первом запросе Map или Route,
+    // поэтому пакет из одних Bus и Stop не читает эти части базы
+    using RendererLoader = std::function<const renderer::MapRenderer&()>;
+    using RouterLoader = std::function<const transport_router::TRouter&()>;
+
     RequestHandler(trans_ctl::TransportCatalogue& db, const renderer::MapRenderer& renderer, const transport_router::TRouter& router)
-        : db_(db), renderer_(renderer), router_(router) {};
+        : db_(db), renderer_(&renderer), router_(&router) {};
+    RequestHandler(trans_ctl::TransportCatalogue& db, RendererLoader load_renderer, RouterLoader load_router)
+        : db_(db), load_renderer_(std::move(load_renderer)), load_router_(std::move(load_router)) {};
 
     // Возвращает маршрут 
     trans_ctl::Bus* GetBus(const std::string_view& bus_name) const;
 
-    // Возвращает все маршруты
-    std::unordered_map<std::string_view, trans_ctl::Bus*> GetAllBuses() const;
-
     // Возвращает статистику по маршруту 
     trans_ctl::BusStat* GetBusStats(const std::string_view& bus_name);
 
-    // Возвращает цвета маршрутов
-    std::map<trans_ctl::Bus*, svg::Color, trans_ctl::BusCmp> GetBusesColors();
+    // Возвращает цвета маршрутов из палитры
+    std::map<trans_ctl::Bus*, svg::Color, trans_ctl::BusCmp> GetBusesColors(const std::vector<svg::Color>& color_palette) const;
 
     // Возвращает остановку 
     trans_ctl::Stop* GetStop(const std::string_view& stop_name) const;
 
-    // Возвращает маршруты, проходящие через
-    const std::set<trans_ctl::Bus*, trans_ctl::BusCmp> GetBusesByStop(const std::string_view& stop_name) const;
+    // Возвращает id остановки или маршрута, StatRequest::NOT_FOUND, если имени нет в базе
+    uint32_t FindStopId(std::string_view stop_name) const;
+    uint32_t FindBusId(std::string_view bus_name) const;
+
+    // Возвращает статистику по маршруту с данным id
+    trans_ctl::BusStat* GetBusStatsById(uint32_t bus_id);
+
+    // Возвращает маршрут по id
+    const trans_ctl::Bus& GetBusById(uint32_t id) const;
+
+    // Возвращает id маршрутов, проходящих через остановку, отсортированные по имени
+    trans_ctl::BusIdsRange GetBusesByStop(const std::string_view& stop_name) const;
+    trans_ctl::BusIdsRange GetBusesByStopId(uint32_t stop_id) const;
+
+    // Возвращает остановку по id
+    const trans_ctl::Stop& GetStopById(uint32_t id) const;
+
+    // Возвращает id остановок, имена которых начинаются с prefix
+    std::vector<uint32_t> SearchStops(std::string_view prefix, size_t limit) const;
+
+    // Возвращает count ближайших к точке остановок
+    std::vector<geo::Neighbor> GetNearestStops(geo::Coordinates coordinates, size_t count) const;
+
+    // Возвращает остановки в радиусе radius метров от точки
+    std::vector<geo::Neighbor> GetStopsInRadius(geo::Coordinates coordinates, double radius) const;
 
     // Находит кратчайший маршрут
     std::optional<graph::Router<double>::RouteInfo> FindRoute(const std::string_view& from, const std::string_view& to) const;
+    std::optional<graph::Router<double>::RouteInfo> FindRoute(uint32_t from_id, uint32_t to_id) const;
 
-    graph::DirectedWeightedGraph<double> GetGraph() const;
+    const graph::DirectedWeightedGraph<double>& GetGraph() const;
 
-    transport_router::EdgeIdtoBus GetEdgeInfo(size_t id) const;
+    transport_router::EdgeInfo GetEdgeInfo(size_t id) const;
 
-    const render::RenderSettings GetRenderSettings() const;
+    const render::RenderSettings& GetRenderSettings() const;
 
     svg::Document RenderMap();
 
 private:
     // RequestHandler использует агрегацию объектов "Транспортный Справочник", "Визуализатор Карты" и "Маршрутизатор"
     trans_ctl::TransportCatalogue& db_;
-    const renderer::MapRenderer& renderer_;
-    const transport_router::TRouter& router_;
+    RendererLoader load_renderer_;
+    RouterLoader load_router_;
+    mutable const renderer::MapRenderer* renderer_ = nullptr;
+    mutable const transport_router::TRouter* router_ = nullptr;
+
+    const renderer::MapRenderer& GetRenderer() const;
+    const transport_router::TRouter& GetRouter() const;
 };
@@ -1,146 +1,298 @@
 #include "serialization.h"
+#include "checksum.h"
+
+#include <google/protobuf/arena.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <google/protobuf/wire_format_lite.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <tuple>
 
 namespace serialize {
 
+	BaseHeader MakeBaseHeader(const char (&magic)[8], uint32_t version, uint32_t section_count) {
+		BaseHeader header{};
+		std::memcpy(header.magic, magic, sizeof(header.magic));
+		header.version = version;
+		header.byte_order = BYTE_ORDER_MARK;
+		header.section_count = section_count;
+		return header;
+	}
+
+	uint32_t ComputeHeaderCrc(BaseHeader header, std::string_view directory) {
+		header.header_crc = 0;
+		const uint32_t crc = checksum::Crc32c({ reinterpret_cast<const char*>(&header), sizeof(header) });
+		return checksum::Crc32c(directory, crc);
+	}
+
+	BaseHeader ReadBaseHeader(std::string_view data, const char (&magic)[8], uint32_t version, size_t entry_size) {
+		BaseHeader header;
+		if (data.size() < sizeof(header) || std::memcmp(data.data(), magic, sizeof(header.magic)) != 0) {
+			throw std::runtime_error("Unknown base file format, rebuild the base with make_base");
+		}
+		std::memcpy(&header, data.data(), sizeof(header));
+		if (header.byte_order != BYTE_ORDER_MARK) {
+			throw std::runtime_error("Base file byte order does not match this machine");
+		}
+		if (header.version != version) {
+			throw std::runtime_error("Unsupported base file version, rebuild the base with make_base");
+		}
+		if ((data.size() - sizeof(header)) / entry_size < header.section_count) {
+			throw std::runtime_error("Base file is truncated");
+		}
+		if (ComputeHeaderCrc(header, data.substr(sizeof(header), header.section_count * entry_size)) != header.header_crc) {
+			throw std::runtime_error("Base file header checksum mismatch");
+		}
+		return header;
+	}
+
 	/*--------------------------------------------------------------------- SERIALIZE ----------------------------------------------------------------------*/
 
-	void Serializer::SerializeStops() {
-		const auto& stops_map = catalogue_.GetAllStops();
-		uint32_t id = 0;
+	namespace {
+		using google::protobuf::internal::WireFormatLite;
+		using google::protobuf::io::CodedOutputStream;
 
-		for (const auto& [key, stop_ptr] : stops_map) {
-			trans_catalogue_serialize::Stop* serialize_stop = serialized_catalogue_.add_stop();
-			//serialize name
-			std::string stop_name = stop_ptr->name;
-			std::vector<uint8_t> encoded_name(stop_name.begin(), stop_name.end());
-			serialize_stop->set_name(encoded_name.data(), encoded_name.size());
+		// Пишет часть базы прямо в байты по одному элементу: каждый элемент - поле TransportCatalogue
+		// с префиксом длины, собранное в переиспользуемом сообщении. Байты те же, что у целого
+		// сообщения части, но дерево сообщений всех элементов не строится.
+		// Байты готовы после разрушения PartStream
+		class PartStream {
+		public:
+			explicit PartStream(std::string& bytes) : stream_(&bytes), output_(&stream_) {}
 
-			//serialize coordinates
-			serialize_stop->mutable_coordinates()->set_lat(stop_ptr->coordinates.lat);
-			serialize_stop->mutable_coordinates()->set_lng(stop_ptr->coordinates.lng);
+			static size_t FieldSize(int field_number, const google::protobuf::MessageLite& message) {
+				return FieldSize(field_number, message.ByteSizeLong());
+			}
 
-			//serialize id
-			serialize_stop->set_id(id);
-			stop_to_id.insert({ stop_name, id });
-			++id;
+			static size_t FieldSize(int field_number, size_t size) {
+				const uint32_t tag = WireFormatLite::MakeTag(field_number, WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+				return CodedOutputStream::VarintSize32(tag) + CodedOutputStream::VarintSize32(static_cast<uint32_t>(size)) + size;
+			}
+
+			// Начало поля-сообщения из size байт: следом пишутся его поля
+			void BeginMessage(int field_number, size_t size) {
+				output_.WriteTag(WireFormatLite::MakeTag(field_number, WireFormatLite::WIRETYPE_LENGTH_DELIMITED));
+				output_.WriteVarint32(static_cast<uint32_t>(size));
+			}
+
+			void WriteMessage(int field_number, const google::protobuf::MessageLite& message) {
+				BeginMessage(field_number, message.ByteSizeLong());
+				message.SerializeWithCachedSizes(&output_);
+			}
+
+			void WriteBytes(int field_number, std::string_view bytes) {
+				BeginMessage(field_number, bytes.size());
+				output_.WriteRaw(bytes.data(), static_cast<int>(bytes.size()));
+			}
+
+			// Упакованное повторяющееся поле uint32, как его пишет protobuf для proto3
+			void WritePacked(int field_number, const std::vector<uint32_t>& values) {
+				if (values.empty()) {
+					return;
+				}
+				size_t size = 0;
+				for (uint32_t value : values) {
+					size += CodedOutputStream::VarintSize32(value);
+				}
+				BeginMessage(field_number, size);
+				for (uint32_t value : values) {
+					output_.WriteVarint32(value);
+				}
+			}
+
+		private:
+			google::protobuf::io::StringOutputStream stream_;
+			CodedOutputStream output_;
+		};
+
+		using CatalogueMessage = trans_catalogue_serialize::TransportCatalogue;
+	}
+
+	void Serializer::StorePart(BasePart id, const trans_catalogue_serialize::TransportCatalogue& part) {
+		StorePart(id, part.SerializeAsString());
+	}
+
+	void Serializer::StorePart(BasePart id, std::string bytes) {
+		//a concatenation of serialized messages parses as their merge, so parts can be written one after another
+		const auto index = static_cast<size_t>(id);
+		directory_[index] = { bytes.size(), checksum::Crc32c(bytes), 0 };
+		part_hashes_[index] = checksum::Hash64(bytes);
+		parts_[index] = std::move(bytes);
+	}
+
+	void Serializer::SerializeStops() {
+		std::string bytes;
+		{
+			PartStream part(bytes);
+			trans_catalogue_serialize::Stop serialize_stop;
+			for (const auto& stop : catalogue_.GetStops()) {
+				serialize_stop.Clear();
+				//serialize name
+				serialize_stop.set_name(stop.name);
+
+				//serialize coordinates
+				serialize_stop.mutable_coordinates()->set_lat(stop.coordinates.lat);
+				serialize_stop.mutable_coordinates()->set_lng(stop.coordinates.lng);
+
+				//serialize buses passing through the stop, already sorted by name
+				for (uint32_t bus_id : catalogue_.GetStopBuses(stop.id)) {
+					serialize_stop.add_buses_by_id(bus_id);
+				}
+				part.WriteMessage(CatalogueMessage::kStopFieldNumber, serialize_stop);
+			}
+			part.WritePacked(CatalogueMessage::kStopSpatialIndexFieldNumber, catalogue_.GetSpatialIndex().GetOrder());
 		}
+		StorePart(BasePart::STOPS, std::move(bytes));
 	}
 
 	void Serializer::SerializeStopDistances() {
-		const auto& stop_lenghts = catalogue_.GetAllStopLengths();
-		for (const auto& [stops, distance] : stop_lenghts) {
-			trans_catalogue_serialize::StopDistances* serialize_stop_distances = serialized_catalogue_.add_distance();
-			auto first_stop_name = stops.first->name;
-			auto second_stop_name = stops.second->name;
-
-			serialize_stop_distances->set_first_id(stop_to_id.at(first_stop_name));
-			serialize_stop_distances->set_second_id(stop_to_id.at(second_stop_name));
-			serialize_stop_distances->set_distance(distance);
+		//the hash map order depends on stop addresses, sorting by ids keeps the base byte-identical between runs
+		std::vector<std::tuple<uint32_t, uint32_t, double>> distances;
+		distances.reserve(catalogue_.GetAllStopLengths().size());
+		for (const auto& [stops, distance] : catalogue_.GetAllStopLengths()) {
+			distances.emplace_back(stops.first->id, stops.second->id, distance);
 		}
+		std::sort(distances.begin(), distances.end());
+
+		std::string bytes;
+		{
+			PartStream part(bytes);
+			trans_catalogue_serialize::StopDistances serialize_stop_distances;
+			for (const auto& [first_id, second_id, distance] : distances) {
+				serialize_stop_distances.set_first_id(first_id);
+				serialize_stop_distances.set_second_id(second_id);
+				serialize_stop_distances.set_distance(distance);
+				part.WriteMessage(CatalogueMessage::kDistanceFieldNumber, serialize_stop_distances);
+			}
+		}
+		StorePart(BasePart::STOP_DISTANCES, std::move(bytes));
 	}
 
 	void Serializer::SerializeBusses() {
-		const auto& routes_map = catalogue_.GetAllRoutes();
-		for (const auto& [key, bus_ptr] : routes_map) {
-			trans_catalogue_serialize::Bus* serialize_bus = serialized_catalogue_.add_route();
-			//serialize name
-			std::string bus_name = bus_ptr->name;
-			std::vector<uint8_t> encoded_name(bus_name.begin(), bus_name.end());
-			serialize_bus->set_name(encoded_name.data(), encoded_name.size());
-
-			//serialize stops
-			for (const auto& stop : bus_ptr->stops) {
-				std::string stop_name = stop->name;
-				serialize_bus->add_stops_by_id(stop_to_id.at(stop_name));
+		std::string bytes;
+		{
+			PartStream part(bytes);
+			trans_catalogue_serialize::Bus serialize_bus;
+			for (const auto& bus : catalogue_.GetBuses()) {
+				serialize_bus.Clear();
+				//serialize name
+				serialize_bus.set_name(bus.name);
+
+				//serialize stops
+				serialize_bus.mutable_stops_by_id()->Reserve(static_cast<int>(bus.stops.size()));
+				for (const auto& stop : bus.stops) {
+					serialize_bus.add_stops_by_id(stop->id);
+				}
+
+				//serialize route type
+				serialize_bus.set_is_circle_route(bus.isCircleRoute);
+
+				//serialize statistics
+				serialize_bus.mutable_stat()->set_stops_count(static_cast<int>(bus.stat.stops_count));
+				serialize_bus.mutable_stat()->set_unique_stops_count(static_cast<int>(bus.stat.unique_stops_count));
+				serialize_bus.mutable_stat()->set_route_distance(bus.stat.route_distance);
+				serialize_bus.mutable_stat()->set_route_length(bus.stat.route_length);
+				part.WriteMessage(CatalogueMessage::kRouteFieldNumber, serialize_bus);
 			}
 
-			//serialize route type
-			serialize_bus->set_is_circle_route(bus_ptr->isCircleRoute);
-
-			//serialize statistics
-			serialize_bus->mutable_stat()->set_stops_count(static_cast<int>(bus_ptr->stat.stops_count));
-			serialize_bus->mutable_stat()->set_unique_stops_count(static_cast<int>(bus_ptr->stat.unique_stops_count));
-			serialize_bus->mutable_stat()->set_route_distance(static_cast<int>(bus_ptr->stat.route_distance));
-			serialize_bus->mutable_stat()->set_route_length(static_cast<int>(bus_ptr->stat.route_length));
+			//name indexes are stored as they are, lookups on load go through them without hashing
+			part.WriteBytes(CatalogueMessage::kStopNamesIndexFieldNumber, catalogue_.GetStopsNameIndex().GetData());
+			part.WriteBytes(CatalogueMessage::kBusNamesIndexFieldNumber, catalogue_.GetBusesNameIndex().GetData());
 		}
+		StorePart(BasePart::BUSES, std::move(bytes));
 	}
 
 	void Serializer::SerializeRenderSettings(const JsonReader& json_reader, const json::Document& document) {
-		render::RenderSettings render_settings = json_reader.ParseRenderSettings(document);
-
-		render_settings_serialize::RenderSettings* render_settings_ = serialized_catalogue_.mutable_render_settings();
-
-		render_settings_->mutable_size()->set_width(render_settings.size.width);
-		render_settings_->mutable_size()->set_height(render_settings.size.height);
-		render_settings_->set_padding(render_settings.padding);
-		render_settings_->set_line_width(render_settings.line_width);
-		render_settings_->set_stop_radius(render_settings.stop_radius);
-		render_settings_->set_bus_label_font_size(render_settings.bus_label_font_size);
-		render_settings_->mutable_bus_label_offset()->set_dx(render_settings.bus_label_offset.dx);
-		render_settings_->mutable_bus_label_offset()->set_dy(render_settings.bus_label_offset.dy);
-		render_settings_->set_stop_label_font_size(render_settings.stop_label_font_size);
-		render_settings_->mutable_stop_label_offset()->set_dx(render_settings.stop_label_offset.dx);
-		render_settings_->mutable_stop_label_offset()->set_dy(render_settings.stop_label_offset.dy);
-		*render_settings_->mutable_underlayer_color() = SerializeColor(render_settings.underlayer_color);
-		render_settings_->set_underlayer_width(render_settings.underlayer_width);
-
-		for (const auto& color : render_settings.color_palette) {
-			*render_settings_->add_color_palette() = SerializeColor(color);
-		}
+		trans_catalogue_serialize::TransportCatalogue part;
+		*part.mutable_render_settings() = RenderSettingsToMessage(json_reader.ParseRenderSettings(document));
+		StorePart(BasePart::RENDER_SETTINGS, part);
 	}
 
 	void Serializer::SerializeRouterSettings(const JsonReader& json_reader, const json::Document& document) {
 		transport_router::Routing_settings routing_settings = json_reader.ParseRoutingSettings(document);
 
-		router_serialize::RoutingSettings* routing_settings_ = serialized_catalogue_.mutable_routing_settings();
+		trans_catalogue_serialize::TransportCatalogue part;
+		router_serialize::RoutingSettings* routing_settings_ = part.mutable_routing_settings();
 		routing_settings_->set_bus_wait_time(routing_settings.bus_wait_time);
 		routing_settings_->set_bus_velocity(routing_settings.bus_velocity);
+		StorePart(BasePart::ROUTING_SETTINGS, part);
 	}
 
 	void Serializer::SerializeGraph(const graph::DirectedWeightedGraph<double>& graph) {
-		size_t edge_count = graph.GetEdgeCount();
-		for (size_t i = 0; i < edge_count; ++i) {
-			graph_serialize::Edge* serialize_edge = serialized_catalogue_.mutable_graph()->add_edge();
+		const size_t edge_count = graph.GetEdgeCount();
+		const size_t incidence_list_count = graph.GetVertexCount();
+		graph_serialize::Edge serialize_edge;
+		auto fill_edge = [&graph, &serialize_edge](size_t i) {
+			serialize_edge.set_from(graph.GetEdge(i).from);
+			serialize_edge.set_to(graph.GetEdge(i).to);
+			serialize_edge.set_weight(graph.GetEdge(i).weight);
+		};
+		graph_serialize::IncidenceList serialize_incidence_list;
+		auto fill_incidence_list = [&graph, &serialize_incidence_list](size_t i) {
+			serialize_incidence_list.clear_edge_id();
+			for (const auto& edge_id : graph.GetIncidentEdges(i)) {
+				serialize_incidence_list.add_edge_id(static_cast<uint32_t>(edge_id));
+			}
+		};
 
-			serialize_edge->set_from(graph.GetEdge(i).from);
-			serialize_edge->set_to(graph.GetEdge(i).to);
-			serialize_edge->set_weight(graph.GetEdge(i).weight);
+		//the graph is a single field, so its length is summed in a first pass over the same messages
+		size_t graph_size = 0;
+		for (size_t i = 0; i < edge_count; ++i) {
+			fill_edge(i);
+			graph_size += PartStream::FieldSize(graph_serialize::Graph::kEdgeFieldNumber, serialize_edge);
 		}
-		size_t incidence_list_count = graph.GetVertexCount();
 		for (size_t i = 0; i < incidence_list_count; ++i) {
-			graph_serialize::IncidenceList* serialize_incidence_list = serialized_catalogue_.mutable_graph()->add_incidence_list();
+			fill_incidence_list(i);
+			graph_size += PartStream::FieldSize(graph_serialize::Graph::kIncidenceListFieldNumber, serialize_incidence_list);
+		}
 
-			for (const auto& edge_id : graph.GetIncidentEdges(i)) {
-				serialize_incidence_list->add_edge_id(edge_id);
+		std::string bytes;
+		bytes.reserve(PartStream::FieldSize(CatalogueMessage::kGraphFieldNumber, graph_size));
+		{
+			PartStream part(bytes);
+			part.BeginMessage(CatalogueMessage::kGraphFieldNumber, graph_size);
+			for (size_t i = 0; i < edge_count; ++i) {
+				fill_edge(i);
+				part.WriteMessage(graph_serialize::Graph::kEdgeFieldNumber, serialize_edge);
+			}
+			for (size_t i = 0; i < incidence_list_count; ++i) {
+				fill_incidence_list(i);
+				part.WriteMessage(graph_serialize::Graph::kIncidenceListFieldNumber, serialize_incidence_list);
 			}
 		}
+		StorePart(BasePart::GRAPH, std::move(bytes));
 	}
 
 	void Serializer::SerializeRouter(const transport_router::TRouter& router) {
-		router_serialize::Router* router_ = serialized_catalogue_.mutable_router();
-
-		auto waiting_stops_ids_ = router.GetWaitingStopsIds();
-		for (const auto& [name, id] : waiting_stops_ids_) {
-			router_serialize::MapWaitingStopsIds* serialize_waiting_stops = router_->add_waiting_stops_ids();
-			serialize_waiting_stops->set_key(name.data(), name.size());
-			serialize_waiting_stops->set_value(id);
+		trans_catalogue_serialize::TransportCatalogue part;
+		router_serialize::Router* router_ = part.mutable_router();
+
+		//vertices are indexed by stop id
+		const auto& waiting_stops_ids_ = router.GetWaitingStopsIds();
+		router_->mutable_waiting_vertex()->Reserve(static_cast<int>(waiting_stops_ids_.size()));
+		for (size_t vertex : waiting_stops_ids_) {
+			router_->add_waiting_vertex(static_cast<uint32_t>(vertex));
 		}
 
-		auto stops_ids_ = router.GetStopsIds();
-		for (const auto& [name, id] : stops_ids_) {
-			router_serialize::MapStopsIds* serialize_stops = router_->add_stops_ids();
-			serialize_stops->set_key(name.data(), name.size());
-			serialize_stops->set_value(id);
+		const auto& stops_ids_ = router.GetStopsIds();
+		router_->mutable_stop_vertex()->Reserve(static_cast<int>(stops_ids_.size()));
+		for (size_t vertex : stops_ids_) {
+			router_->add_stop_vertex(static_cast<uint32_t>(vertex));
 		}
 
-		auto edge_ids_ = router.GetEdgeIdMap();
-		for (const auto& [id, edge] : edge_ids_) {
-			router_serialize::MapEdges* serialize_edge = router_->add_id_to_bus_stop();
-			serialize_edge->set_key(id);
-			serialize_edge->mutable_value()->set_bus_name(edge.bus_name.data(), edge.bus_name.size());
-			serialize_edge->mutable_value()->set_stop_name(edge.stop_name.data(), edge.stop_name.size());
-			serialize_edge->mutable_value()->set_span_count(edge.span_count);
+		//edge metadata goes as packed parallel arrays indexed by edge id
+		const auto& edges_info_ = router.GetEdgesInfo();
+		router_->mutable_edge_kind()->Reserve(static_cast<int>(edges_info_.Size()));
+		for (transport_router::EdgeKind kind : edges_info_.kinds) {
+			router_->add_edge_kind(kind == transport_router::EdgeKind::WAIT ? router_serialize::WAIT : router_serialize::BUS);
 		}
+		router_->mutable_edge_bus_id()->Add(edges_info_.bus_ids.begin(), edges_info_.bus_ids.end());
+		router_->mutable_edge_stop_id()->Add(edges_info_.stop_ids.begin(), edges_info_.stop_ids.end());
+		router_->mutable_edge_span_count()->Add(edges_info_.span_counts.begin(), edges_info_.span_counts.end());
+		StorePart(BasePart::ROUTER, part);
 	}
 
 	void Serializer::SerializeTransportCatalogue()
@@ -150,174 +302,321 @@ namespace serialize {
 		SerializeBusses();
 	}
 
+	void Serializer::WriteHeader(std::ostream& output) {
+		BaseHeader header = MakeBaseHeader(pb::MAGIC, pb::VERSION, static_cast<uint32_t>(directory_.size()));
+		header.content_hash = content_hash_;
+		const std::string_view directory(reinterpret_cast<const char*>(directory_.data()), directory_.size() * sizeof(pb::PartEntry));
+		header.header_crc = ComputeHeaderCrc(header, directory);
+		output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		output.write(directory.data(), directory.size());
+	}
+
+	void Serializer::WritePart(BasePart id, std::ostream& output) {
+		if (!header_written_) {
+			//other parts may still be serialized, so the directory is read only in FinishWrite, after all of them
+			const std::string placeholder(sizeof(BaseHeader) + directory_.size() * sizeof(pb::PartEntry), '\0');
+			output.write(placeholder.data(), placeholder.size());
+			header_written_ = true;
+		}
+		const auto index = static_cast<size_t>(id);
+		std::string& part = parts_[index];
+		output.write(part.data(), part.size());
+		std::string().swap(part);
+
+		const uint64_t summary[] = { index, directory_[index].size, part_hashes_[index] };
+		content_hash_ = checksum::Hash64({ reinterpret_cast<const char*>(summary), sizeof(summary) }, content_hash_);
+	}
+
+	void Serializer::FinishWrite(std::ostream& output) {
+		if (!header_written_) {
+			WriteHeader(output);
+		}
+		else {
+			output.seekp(0);
+			WriteHeader(output);
+			output.seekp(0, std::ios::end);
+		}
+		output.flush();
+	}
+
 	void Serializer::SaveTo(std::ostream& output) {
-		serialized_catalogue_.SerializeToOstream(&output);
+		for (size_t id = 0; id < parts_.size(); ++id) {
+			WritePart(static_cast<BasePart>(id), output);
+		}
+		FinishWrite(output);
 	}
 
 	/*--------------------------------------------------------------------- DESERIALIZE ----------------------------------------------------------------------*/
 
-	void Deserializer::DeserializeStops(std::istream& input) {
-		if (serialized_catalogue_.ParseFromIstream(&input)) {
-			int stops_count = serialized_catalogue_.stop_size();
-			for (int i = 0; i < stops_count; ++i) {
-				trans_ctl::Stop stop;
-				//deserialize name
-				stop.name = serialized_catalogue_.mutable_stop(i)->name();
+	namespace {
+		trans_ctl::Stop* GetStop(const trans_ctl::TransportCatalogue& catalogue, uint32_t id) {
+			if (id >= catalogue.GetStopsCount()) {
+				throw std::runtime_error("Deserialization Error!");
+			}
+			return const_cast<trans_ctl::Stop*>(&catalogue.GetStopById(id));
+		}
 
-				//deserialize coordinates
-				stop.coordinates.lat = serialized_catalogue_.mutable_stop(i)->coordinates().lat();
-				stop.coordinates.lng = serialized_catalogue_.mutable_stop(i)->coordinates().lng();
+		trans_ctl::Bus* GetBus(const trans_ctl::TransportCatalogue& catalogue, uint32_t id) {
+			if (id >= catalogue.GetBuses().size()) {
+				throw std::runtime_error("Deserialization Error!");
+			}
+			return const_cast<trans_ctl::Bus*>(&catalogue.GetBusById(id));
+		}
 
-				id_to_stop.insert({ serialized_catalogue_.mutable_stop(i)->id(), stop.name });
+		void MergeFromData(google::protobuf::MessageLite& message, std::string_view data) {
+			google::protobuf::io::CodedInputStream input(reinterpret_cast<const uint8_t*>(data.data()), static_cast<int>(data.size()));
+			if (!message.MergeFromCodedStream(&input)) {
+				throw std::runtime_error("Deserialization Error!");
+			}
+		}
+	}
 
-				//add full stop structs to catalogue
-				catalogue_.AddStop(stop);
+	Deserializer::Deserializer(std::string_view base) {
+		//checksums are verified before anything is parsed
+		const BaseHeader header = ReadBaseHeader(base, pb::MAGIC, pb::VERSION, sizeof(pb::PartEntry));
+		size_t offset = sizeof(header) + header.section_count * sizeof(pb::PartEntry);
+		for (uint32_t i = 0; i < header.section_count; ++i) {
+			pb::PartEntry entry;
+			std::memcpy(&entry, base.data() + sizeof(header) + i * sizeof(entry), sizeof(entry));
+			if (entry.size > base.size() - offset) {
+				throw std::runtime_error("Base file is truncated");
+			}
+			if (checksum::Crc32c(base.substr(offset, entry.size)) != entry.crc) {
+				throw std::runtime_error("Base file checksum mismatch");
 			}
+			offset += entry.size;
 		}
-		else {
-			throw std::runtime_error("Deserialization Error!");
+		if (offset != base.size()) {
+			throw std::runtime_error("Base file has trailing data");
 		}
+
+		//parts are parsed one at a time when they are needed
+		parts_.assign(static_cast<size_t>(BasePart::COUNT), {});
+		offset = sizeof(header) + header.section_count * sizeof(pb::PartEntry);
+		for (uint32_t i = 0; i < header.section_count; ++i) {
+			pb::PartEntry entry;
+			std::memcpy(&entry, base.data() + sizeof(header) + i * sizeof(entry), sizeof(entry));
+			if (i < parts_.size()) {
+				parts_[i] = base.substr(offset, entry.size);
+			}
+			offset += entry.size;
+		}
+	}
+
+	trans_catalogue_serialize::TransportCatalogue& Deserializer::ParsePart(google::protobuf::Arena& arena, BasePart id) const {
+		auto* part = google::protobuf::Arena::CreateMessage<trans_catalogue_serialize::TransportCatalogue>(&arena);
+		MergeFromData(*part, parts_.at(static_cast<size_t>(id)));
+		return *part;
 	}
 
-	void Deserializer::DeserializeStopDistances() {
-		int distances_count = serialized_catalogue_.distance_size();
-		for (int i = 0; i < distances_count; ++i) {
-			auto first_stop_name = id_to_stop.at(serialized_catalogue_.mutable_distance(i)->first_id());
-			auto second_stop_name = id_to_stop.at(serialized_catalogue_.mutable_distance(i)->second_id());
+	void Deserializer::DeserializeStops(const trans_catalogue_serialize::TransportCatalogue& stops_part) {
+		std::vector<uint32_t> stop_buses_offsets(1, 0);
+		std::vector<uint32_t> stop_buses;
+		for (const auto& serialized_stop : stops_part.stop()) {
+			trans_ctl::Stop stop;
+			//deserialize name
+			stop.name = serialized_stop.name();
+
+			//deserialize coordinates
+			stop.coordinates.lat = serialized_stop.coordinates().lat();
+			stop.coordinates.lng = serialized_stop.coordinates().lng();
+
+			//deserialize buses passing through the stop
+			const auto& buses_by_id = serialized_stop.buses_by_id();
+			stop_buses.insert(stop_buses.end(), buses_by_id.begin(), buses_by_id.end());
+			stop_buses_offsets.push_back(static_cast<uint32_t>(stop_buses.size()));
+
+			//add full stop structs to catalogue
+			catalogue_.AddStop(std::move(stop));
+		}
+		catalogue_.SetStopBuses(std::move(stop_buses_offsets), std::move(stop_buses));
+
+		const auto& spatial_index = stops_part.stop_spatial_index();
+		catalogue_.SetSpatialIndex({ spatial_index.begin(), spatial_index.end() });
+	}
 
-			trans_ctl::Stop* first_stop = catalogue_.FindStop(first_stop_name);
-			trans_ctl::Stop* second_stop = catalogue_.FindStop(second_stop_name);
-			double distance = serialized_catalogue_.mutable_distance(i)->distance();
+	void Deserializer::DeserializeStopDistances(const trans_catalogue_serialize::TransportCatalogue& part) {
+		for (const auto& serialized_distance : part.distance()) {
+			trans_ctl::Stop* first_stop = GetStop(catalogue_, serialized_distance.first_id());
+			trans_ctl::Stop* second_stop = GetStop(catalogue_, serialized_distance.second_id());
 
 			//add distance struct to catalogue
-			catalogue_.SetStopsLength(first_stop, second_stop, distance);
+			catalogue_.SetStopsLength(first_stop, second_stop, serialized_distance.distance());
 		}
 	}
 
-	void Deserializer::DeserializeBusses() {
-		int buses_count = serialized_catalogue_.route_size();
-		for (int i = 0; i < buses_count; ++i) {
+	void Deserializer::DeserializeBusses(trans_catalogue_serialize::TransportCatalogue& part) {
+		//lookups by name go through the stored indexes, nothing is hashed on load
+		catalogue_.SetNameIndexes(std::move(*part.mutable_stop_names_index()), std::move(*part.mutable_bus_names_index()));
+
+		for (const auto& serialized_bus : part.route()) {
 			trans_ctl::Bus bus;
 			//deserialize name
-			bus.name = serialized_catalogue_.mutable_route(i)->name();
+			bus.name = serialized_bus.name();
 
-			//deserialize stops
-			int stops_in_bus_count = serialized_catalogue_.mutable_route(i)->stops_by_id_size();
-			for (int j = 0; j < stops_in_bus_count; ++j) {
-				std::string stop_name = id_to_stop.at(serialized_catalogue_.mutable_route(i)->stops_by_id(j));
-				bus.stops.push_back(catalogue_.FindStop(stop_name));
+			//deserialize stops, ids are indexes into the catalogue
+			const auto& stops_by_id = serialized_bus.stops_by_id();
+			bus.stops.reserve(stops_by_id.size());
+			for (uint32_t stop_id : stops_by_id) {
+				bus.stops.push_back(GetStop(catalogue_, stop_id));
 			}
 
 			//deserialize route type
-			bus.isCircleRoute = serialized_catalogue_.mutable_route(i)->is_circle_route();
+			bus.isCircleRoute = serialized_bus.is_circle_route();
 
 			//deserialize bus stats
-			bus.stat.stops_count = serialized_catalogue_.mutable_route(i)->stat().stops_count();
-			bus.stat.unique_stops_count = serialized_catalogue_.mutable_route(i)->stat().unique_stops_count();
-			bus.stat.route_distance = serialized_catalogue_.mutable_route(i)->stat().route_distance();
-			bus.stat.route_length = serialized_catalogue_.mutable_route(i)->stat().route_length();
+			bus.stat.stops_count = serialized_bus.stat().stops_count();
+			bus.stat.unique_stops_count = serialized_bus.stat().unique_stops_count();
+			bus.stat.route_distance = serialized_bus.stat().route_distance();
+			bus.stat.route_length = serialized_bus.stat().route_length();
 
 			//add full bus structs to catalogue
-			catalogue_.AddBus(bus);
+			catalogue_.AddBus(std::move(bus));
 		}
 	}
 
 	render::RenderSettings Deserializer::DeserializeRenderSettings() {
-		render::RenderSettings render_settings_;
-
-		render_settings_.size.width = serialized_catalogue_.render_settings().size().width();
-		render_settings_.size.height = serialized_catalogue_.render_settings().size().height();
-		render_settings_.padding = serialized_catalogue_.render_settings().padding();
-		render_settings_.line_width = serialized_catalogue_.render_settings().line_width();
-		render_settings_.stop_radius = serialized_catalogue_.render_settings().stop_radius();
-		render_settings_.bus_label_font_size = serialized_catalogue_.render_settings().bus_label_font_size();
-		render_settings_.bus_label_offset.dx = serialized_catalogue_.render_settings().bus_label_offset().dx();
-		render_settings_.bus_label_offset.dy = serialized_catalogue_.render_settings().bus_label_offset().dy();
-		render_settings_.stop_label_font_size = serialized_catalogue_.render_settings().stop_label_font_size();
-		render_settings_.stop_label_offset.dx = serialized_catalogue_.render_settings().stop_label_offset().dx();
-		render_settings_.stop_label_offset.dy = serialized_catalogue_.render_settings().stop_label_offset().dy();
-		render_settings_.underlayer_color = DeserializeColor(serialized_catalogue_.render_settings().underlayer_color());
-		render_settings_.underlayer_width = serialized_catalogue_.render_settings().underlayer_width();
-
-		int color_palette_size = serialized_catalogue_.render_settings().color_palette_size();
-		for (int i = 0; i < color_palette_size; ++i) {
-			svg::Color current_color = DeserializeColor(*serialized_catalogue_.mutable_render_settings()->mutable_color_palette(i));
-			render_settings_.color_palette.push_back(current_color);
-		}
-
-		return render_settings_;
+		google::protobuf::Arena arena;
+		return RenderSettingsFromMessage(ParsePart(arena, BasePart::RENDER_SETTINGS).render_settings());
 	}
 
 	transport_router::Routing_settings Deserializer::DeserializeRouterSettings() {
+		google::protobuf::Arena arena;
+		const auto& part = ParsePart(arena, BasePart::ROUTING_SETTINGS);
 		transport_router::Routing_settings routing_settings_;
 
-		routing_settings_.bus_wait_time = serialized_catalogue_.routing_settings().bus_wait_time();
-		routing_settings_.bus_velocity = serialized_catalogue_.routing_settings().bus_velocity();
+		routing_settings_.bus_wait_time = part.routing_settings().bus_wait_time();
+		routing_settings_.bus_velocity = part.routing_settings().bus_velocity();
 
 		return routing_settings_;
 	}
 
 	graph::DirectedWeightedGraph<double> Deserializer::DeserializeGraph() {
-		int vertex_count = serialized_catalogue_.graph().incidence_list_size();
-		graph::DirectedWeightedGraph<double> graph_(vertex_count);
+		google::protobuf::Arena arena;
+		const auto& serialized_graph = ParsePart(arena, BasePart::GRAPH).graph();
+		graph::DirectedWeightedGraph<double> graph_(serialized_graph.incidence_list_size());
 
-		int edge_count = serialized_catalogue_.graph().edge_size();
-		for (int i = 0; i < edge_count; ++i) {
-			graph_.AddEdge({ serialized_catalogue_.graph().edge(i).from(), serialized_catalogue_.graph().edge(i).to(), serialized_catalogue_.graph().edge(i).weight() });
+		for (const auto& edge : serialized_graph.edge()) {
+			graph_.AddEdge({ edge.from(), edge.to(), edge.weight() });
 		}
 
 		return graph_;
 	}
 
 	transport_router::TRouter Deserializer::DeserializeRouter(trans_ctl::TransportCatalogue& catalogue) {
-		std::unordered_map<std::string_view, size_t> waiting_stops_ids_;
-		int waiting_stops_ids_size = serialized_catalogue_.router().waiting_stops_ids_size();
-		for (int i = 0; i < waiting_stops_ids_size; ++i) {
-			trans_ctl::Stop* stop = catalogue.FindStop(serialized_catalogue_.router().waiting_stops_ids(i).key());
-			waiting_stops_ids_.insert({ stop->name, serialized_catalogue_.router().waiting_stops_ids(i).value() });
-		}
-
-		std::unordered_map<std::string_view, size_t> stops_ids_;
-		int stops_ids_size = serialized_catalogue_.router().stops_ids_size();
-		for (int i = 0; i < stops_ids_size; ++i) {
-			trans_ctl::Stop* stop = catalogue.FindStop(serialized_catalogue_.router().stops_ids(i).key());
-			stops_ids_.insert({ stop->name, serialized_catalogue_.router().stops_ids(i).value() });
-		}
-
-		std::unordered_map<size_t, transport_router::EdgeIdtoBus> id_to_bus_stop_;
-		int edge_ids_size = serialized_catalogue_.router().id_to_bus_stop_size();
-		for (int i = 0; i < edge_ids_size; ++i) {
-			transport_router::EdgeIdtoBus edge;
-			trans_ctl::Bus* bus = catalogue.FindBus(serialized_catalogue_.router().id_to_bus_stop(i).value().bus_name());
-			if (bus == nullptr) {
-				edge.bus_name = "waiting";
-			}
-			else {
-				edge.bus_name = bus->name;
-			}
-			trans_ctl::Stop* stop = catalogue.FindStop(serialized_catalogue_.router().id_to_bus_stop(i).value().stop_name());
-			edge.stop_name = stop->name;
-			edge.span_count = serialized_catalogue_.router().id_to_bus_stop(i).value().span_count();
+		google::protobuf::Arena arena;
+		const auto& router = ParsePart(arena, BasePart::ROUTER).router();
 
-			id_to_bus_stop_.insert({ serialized_catalogue_.router().id_to_bus_stop(i).key(), std::move(edge) });
+		std::vector<size_t> waiting_stops_ids_(router.waiting_vertex().begin(), router.waiting_vertex().end());
+		std::vector<size_t> stops_ids_(router.stop_vertex().begin(), router.stop_vertex().end());
+		if (waiting_stops_ids_.size() != catalogue.GetStopsCount() || stops_ids_.size() != catalogue.GetStopsCount()) {
+			throw std::runtime_error("Deserialization Error!");
 		}
 
-		transport_router::TRouter filled_router(DeserializeRouterSettings(), 
-											    catalogue,
-			                                    waiting_stops_ids_,
-												stops_ids_,
-											    id_to_bus_stop_
-			                                    );
+		const int edges_count = router.edge_kind_size();
+		if (router.edge_bus_id_size() != edges_count || router.edge_stop_id_size() != edges_count
+			|| router.edge_span_count_size() != edges_count) {
+			throw std::runtime_error("Deserialization Error!");
+		}
 
-		return filled_router;
+		transport_router::EdgesInfo edges_info_;
+		edges_info_.kinds.reserve(edges_count);
+		for (int kind : router.edge_kind()) {
+			edges_info_.kinds.push_back(kind == router_serialize::WAIT ? transport_router::EdgeKind::WAIT : transport_router::EdgeKind::BUS);
+		}
+		edges_info_.bus_ids.assign(router.edge_bus_id().begin(), router.edge_bus_id().end());
+		edges_info_.stop_ids.assign(router.edge_stop_id().begin(), router.edge_stop_id().end());
+		edges_info_.span_counts.assign(router.edge_span_count().begin(), router.edge_span_count().end());
+
+		//ids are checked once here, route responses index the catalogue without checks
+		for (int i = 0; i < edges_count; ++i) {
+			GetStop(catalogue, edges_info_.stop_ids[i]);
+			if (edges_info_.kinds[i] == transport_router::EdgeKind::BUS) {
+				GetBus(catalogue, edges_info_.bus_ids[i]);
+			}
+		}
+
+		return transport_router::TRouter(DeserializeRouterSettings(),
+			catalogue,
+			std::move(waiting_stops_ids_),
+			std::move(stops_ids_),
+			std::move(edges_info_));
 	}
 
 	trans_ctl::TransportCatalogue Deserializer::DeserializeTransportCatalogue(std::istream& input)
 	{
-		DeserializeStops(input);
-		DeserializeStopDistances();
-		DeserializeBusses();
-		return catalogue_;
+		owned_data_.assign(std::istreambuf_iterator<char>(input), {});
+		//a message without a header holds every part at once
+		parts_.assign(static_cast<size_t>(BasePart::COUNT), owned_data_);
+		return DeserializeTransportCatalogue();
+	}
+
+	trans_ctl::TransportCatalogue Deserializer::DeserializeTransportCatalogue()
+	{
+		//each part is freed with its arena before the next one is parsed
+		{
+			google::protobuf::Arena arena;
+			DeserializeStops(ParsePart(arena, BasePart::STOPS));
+		}
+		{
+			google::protobuf::Arena arena;
+			DeserializeStopDistances(ParsePart(arena, BasePart::STOP_DISTANCES));
+		}
+		{
+			google::protobuf::Arena arena;
+			DeserializeBusses(ParsePart(arena, BasePart::BUSES));
+		}
+		return std::move(catalogue_);
+	}
+
+	render_settings_serialize::RenderSettings RenderSettingsToMessage(const render::RenderSettings& render_settings) {
+		render_settings_serialize::RenderSettings message;
+
+		message.mutable_size()->set_width(render_settings.size.width);
+		message.mutable_size()->set_height(render_settings.size.height);
+		message.set_padding(render_settings.padding);
+		message.set_line_width(render_settings.line_width);
+		message.set_stop_radius(render_settings.stop_radius);
+		message.set_bus_label_font_size(render_settings.bus_label_font_size);
+		message.mutable_bus_label_offset()->set_dx(render_settings.bus_label_offset.dx);
+		message.mutable_bus_label_offset()->set_dy(render_settings.bus_label_offset.dy);
+		message.set_stop_label_font_size(render_settings.stop_label_font_size);
+		message.mutable_stop_label_offset()->set_dx(render_settings.stop_label_offset.dx);
+		message.mutable_stop_label_offset()->set_dy(render_settings.stop_label_offset.dy);
+		*message.mutable_underlayer_color() = SerializeColor(render_settings.underlayer_color);
+		message.set_underlayer_width(render_settings.underlayer_width);
+
+		for (const auto& color : render_settings.color_palette) {
+			*message.add_color_palette() = SerializeColor(color);
+		}
+
+		return message;
+	}
+
+	render::RenderSettings RenderSettingsFromMessage(const render_settings_serialize::RenderSettings& message) {
+		render::RenderSettings render_settings_;
+
+		render_settings_.size.width = message.size().width();
+		render_settings_.size.height = message.size().height();
+		render_settings_.padding = message.padding();
+		render_settings_.line_width = message.line_width();
+		render_settings_.stop_radius = message.stop_radius();
+		render_settings_.bus_label_font_size = message.bus_label_font_size();
+		render_settings_.bus_label_offset.dx = message.bus_label_offset().dx();
+		render_settings_.bus_label_offset.dy = message.bus_label_offset().dy();
+		render_settings_.stop_label_font_size = message.stop_label_font_size();
+		render_settings_.stop_label_offset.dx = message.stop_label_offset().dx();
+		render_settings_.stop_label_offset.dy = message.stop_label_offset().dy();
+		render_settings_.underlayer_color = DeserializeColor(message.underlayer_color());
+		render_settings_.underlayer_width = message.underlayer_width();
+
+		int color_palette_size = message.color_palette_size();
+		for (int i = 0; i < color_palette_size; ++i) {
+			svg::Color current_color = DeserializeColor(message.color_palette(i));
+			render_settings_.color_palette.push_back(current_color);
+		}
+
+		return render_settings_;
 	}
 
 	svg_serialize::Color SerializeColor(const svg::Color& color) {
@@ -5,50 +5,135 @@
 #include "json_reader.h"
 
 #include <transport_catalogue.pb.h>
+#include <cstdint>
 #include <unordered_map>
 #include <string>
+#include <string_view>
 #include <variant>
+#include <vector>
 
 namespace serialize {
 
+	// Части базы в порядке записи в файл. Каждую часть готовит свой метод Serialize*,
+	// методы для разных частей можно вызывать из разных потоков одновременно
+	enum class BasePart {
+		STOPS,
+		STOP_DISTANCES,
+		BUSES,
+		RENDER_SETTINGS,
+		ROUTING_SETTINGS,
+		GRAPH,
+		ROUTER,
+		COUNT,
+	};
+
+	// Заголовок файла базы, общий для обоих форматов. За ним идёт каталог частей формата.
+	// header_crc - CRC32C заголовка с нулевым header_crc и каталога. content_hash - хеш содержимого
+	// всех частей для ключей кешей: у одинаковых каталогов базы совпадают побайтно
+	struct BaseHeader {
+		char magic[8];
+		uint32_t version;
+		// Записывается как есть: на машине с другим порядком байт читается иначе
+		uint32_t byte_order;
+		uint32_t section_count;
+		uint32_t header_crc;
+		uint64_t content_hash;
+	};
+	static_assert(sizeof(BaseHeader) == 32);
+
+	inline constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+	// Заголовок с заполненными magic, version, byte_order и section_count
+	BaseHeader MakeBaseHeader(const char (&magic)[8], uint32_t version, uint32_t section_count);
+	uint32_t ComputeHeaderCrc(BaseHeader header, std::string_view directory);
+	// Быстрая проверка до разбора: magic, версия, порядок байт, каталог из section_count записей
+	// по entry_size байт в пределах data и его контрольная сумма. Бросает std::runtime_error
+	BaseHeader ReadBaseHeader(std::string_view data, const char (&magic)[8], uint32_t version, size_t entry_size);
+
+	// Формат базы protobuf: заголовок BaseHeader, каталог из PartEntry для каждой BasePart
+	// и части подряд в том же порядке. Части вместе образуют одно сообщение TransportCatalogue:
+	// конкатенация сообщений разбирается как их слияние
+	namespace pb {
+		inline constexpr char MAGIC[8] = { 'T', 'C', 'P', 'R', 'O', 'T', 'O', '\0' };
+		inline constexpr uint32_t VERSION = 1;
+
+		// crc - CRC32C части
+		struct PartEntry {
+			uint64_t size;
+			uint32_t crc;
+			uint32_t reserved;
+		};
+		static_assert(sizeof(PartEntry) == 16);
+	}
+
 	class Serializer {
 	public:
 		explicit Serializer (const trans_ctl::TransportCatalogue& catalogue) : catalogue_(catalogue) {}
 		void SerializeTransportCatalogue();
+		void SerializeStops();
+		void SerializeStopDistances();
+		// Статистику маршрутов нужно посчитать заранее, иначе в базу попадут нули
+		void SerializeBusses();
 		void SerializeRenderSettings(const JsonReader& json_reader, const json::Document& document);
 		void SerializeRouterSettings(const JsonReader& json_reader, const json::Document& document);
 		void SerializeGraph(const graph::DirectedWeightedGraph<double>& graph);
 		void SerializeRouter(const transport_router::TRouter& router);
+		// Дописывает готовую часть в файл и освобождает её память. Части пишутся по порядку BasePart,
+		// после последней вызывается FinishWrite. Первая часть оставляет под заголовок нули:
+		// остальные части в это время ещё могут готовиться, заголовок пишет FinishWrite
+		void WritePart(BasePart id, std::ostream& output);
+		void FinishWrite(std::ostream& output);
 		void SaveTo(std::ostream& output);
 
 	private:
-		trans_catalogue_serialize::TransportCatalogue serialized_catalogue_;
 		const trans_ctl::TransportCatalogue& catalogue_;
-		std::unordered_map<std::string, uint32_t> stop_to_id;
+		std::vector<std::string> parts_ = std::vector<std::string>(static_cast<size_t>(BasePart::COUNT));
+		// Суммы считаются в StorePart, в потоке, который готовил часть
+		std::vector<pb::PartEntry> directory_ = std::vector<pb::PartEntry>(static_cast<size_t>(BasePart::COUNT));
+		std::vector<uint64_t> part_hashes_ = std::vector<uint64_t>(static_cast<size_t>(BasePart::COUNT));
+		bool header_written_ = false;
+		uint64_t content_hash_ = 0;
 
-		void SerializeStops();
-		void SerializeStopDistances();
-		void SerializeBusses();
+		void StorePart(BasePart id, const trans_catalogue_serialize::TransportCatalogue& part);
+		void StorePart(BasePart id, std::string bytes);
+		void WriteHeader(std::ostream& output);
 	};
 
 	class Deserializer {
 	public:
+		Deserializer() = default;
+		// Проверяет базу в готовом буфере, например в отображённом в память файле. Части разбираются
+		// по одной при первом обращении и сразу освобождаются, поэтому data должна жить, пока
+		// не загружены граф и маршрутизатор. Бросает std::runtime_error, если
+		// у базы чужой заголовок или версия или не сходится контрольная сумма какой-либо части
+		explicit Deserializer(std::string_view data);
+
+		// Читает из input сообщение TransportCatalogue без заголовка базы
 		trans_ctl::TransportCatalogue DeserializeTransportCatalogue(std::istream& input);
+		// Каталог из базы, уже разобранной конструктором
+		trans_ctl::TransportCatalogue DeserializeTransportCatalogue();
 		render::RenderSettings DeserializeRenderSettings();
 		transport_router::Routing_settings DeserializeRouterSettings();
 		graph::DirectedWeightedGraph<double> DeserializeGraph();
 		transport_router::TRouter DeserializeRouter(trans_ctl::TransportCatalogue& catalogue);
 
 	private:
-		trans_catalogue_serialize::TransportCatalogue serialized_catalogue_;
+		// Байты частей по порядку BasePart; у сообщения без заголовка каждая часть - всё сообщение
+		std::vector<std::string_view> parts_;
+		std::string owned_data_;
 		trans_ctl::TransportCatalogue catalogue_;
-		std::unordered_map<uint32_t, std::string> id_to_stop;
 
-		void DeserializeStops(std::istream& input);
-		void DeserializeStopDistances();
-		void DeserializeBusses();
+		// Разбирает часть в сообщение на арене: вложенные сообщения части освобождаются вместе
+		// с ареной, а не по одному
+		trans_catalogue_serialize::TransportCatalogue& ParsePart(google::protobuf::Arena& arena, BasePart id) const;
+		void DeserializeStops(const trans_catalogue_serialize::TransportCatalogue& stops_part);
+		void DeserializeStopDistances(const trans_catalogue_serialize::TransportCatalogue& part);
+		// Индексы имён хранятся в части маршрутов и забираются из неё
+		void DeserializeBusses(trans_catalogue_serialize::TransportCatalogue& part);
 	};
 
+	render_settings_serialize::RenderSettings RenderSettingsToMessage(const render::RenderSettings& render_settings);
+	render::RenderSettings RenderSettingsFromMessage(const render_settings_serialize::RenderSettings& message);
 	svg_serialize::Color SerializeColor(const svg::Color& color);
 	svg::Color DeserializeColor(const svg_serialize::Color& color);
 }
@@ -0,0 +1,163 @@
+#include "spatial_index.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace geo {
+
+	namespace {
+		constexpr int DIMENSIONS = 3;
+
+		bool NeighborLess(const Neighbor& lhs, const Neighbor& rhs) {
+			return lhs.distance < rhs.distance || (lhs.distance == rhs.distance && lhs.id < rhs.id);
+		}
+	}
+
+	SpatialIndex::Point SpatialIndex::ToPoint(SpherePoint point) {
+		return { { point.x, point.y, point.z } };
+	}
+
+	void SpatialIndex::Build(const SpherePoints& points) {
+		points_.clear();
+		points_.reserve(points.Size());
+		for (size_t i = 0; i < points.Size(); ++i) {
+			points_.push_back(ToPoint(points.Get(i)));
+		}
+
+		order_.resize(points.Size());
+		for (uint32_t i = 0; i < order_.size(); ++i) { order_[i] = i; }
+		BuildNode(0, order_.size(), 0);
+
+		FillPoints(points);
+	}
+
+	void SpatialIndex::Assign(std::vector<uint32_t> order, const SpherePoints& points) {
+		//the order comes from a base file, it has to list every point exactly once
+		if (order.size() != points.Size()) {
+			throw std::runtime_error("Spatial index does not match the stops count");
+		}
+		std::vector<bool> seen(order.size(), false);
+		for (uint32_t id : order) {
+			if (id >= order.size() || seen[id]) {
+				throw std::runtime_error("Spatial index is not a permutation of stop ids");
+			}
+			seen[id] = true;
+		}
+
+		order_ = std::move(order);
+		FillPoints(points);
+	}
+
+	void SpatialIndex::BuildNode(size_t lo, size_t hi, int axis) {
+		if (hi - lo <= 1) {
+			return;
+		}
+		const size_t mid = lo + (hi - lo) / 2;
+		std::nth_element(order_.begin() + lo, order_.begin() + mid, order_.begin() + hi,
+			[this, axis](uint32_t lhs, uint32_t rhs) {
+				return points_[lhs].xyz[axis] < points_[rhs].xyz[axis];
+			});
+		const int next_axis = (axis + 1) % DIMENSIONS;
+		BuildNode(lo, mid, next_axis);
+		BuildNode(mid + 1, hi, next_axis);
+	}
+
+	void SpatialIndex::FillPoints(const SpherePoints& points) {
+		//points are kept in tree order so that the search walks memory linearly
+		points_.clear();
+		points_.reserve(order_.size());
+		for (uint32_t id : order_) {
+			points_.push_back(ToPoint(points.Get(id)));
+		}
+	}
+
+	double SpatialIndex::ChordSquared(const Point& lhs, const Point& rhs) {
+		double chord_squared = 0.0;
+		for (int i = 0; i < DIMENSIONS; ++i) {
+			const double diff = lhs.xyz[i] - rhs.xyz[i];
+			chord_squared += diff * diff;
+		}
+		return chord_squared;
+	}
+
+	void SpatialIndex::SearchNearest(size_t lo, size_t hi, int axis, const Point& query, size_t count, std::vector<Candidate>& heap) const {
+		if (lo >= hi) {
+			return;
+		}
+		const size_t mid = lo + (hi - lo) / 2;
+		const Point& point = points_[mid];
+		const Candidate candidate{ ChordSquared(point, query), order_[mid] };
+		if (heap.size() < count) {
+			heap.push_back(candidate);
+			std::push_heap(heap.begin(), heap.end());
+		}
+		else if (candidate < heap.front()) {
+			std::pop_heap(heap.begin(), heap.end());
+			heap.back() = candidate;
+			std::push_heap(heap.begin(), heap.end());
+		}
+
+		//сначала спускаемся в половину с запросом, вторую смотрим только если плоскость ближе худшего кандидата
+		const double diff = query.xyz[axis] - point.xyz[axis];
+		const int next_axis = (axis + 1) % DIMENSIONS;
+		const auto [near_lo, near_hi] = diff < 0 ? std::make_pair(lo, mid) : std::make_pair(mid + 1, hi);
+		const auto [far_lo, far_hi] = diff < 0 ? std::make_pair(mid + 1, hi) : std::make_pair(lo, mid);
+		SearchNearest(near_lo, near_hi, next_axis, query, count, heap);
+		if (heap.size() < count || diff * diff <= heap.front().first) {
+			SearchNearest(far_lo, far_hi, next_axis, query, count, heap);
+		}
+	}
+
+	void SpatialIndex::SearchInRadius(size_t lo, size_t hi, int axis, const Point& query, double limit, std::vector<Neighbor>& result) const {
+		if (lo >= hi) {
+			return;
+		}
+		const size_t mid = lo + (hi - lo) / 2;
+		const Point& point = points_[mid];
+		const double chord_squared = ChordSquared(point, query);
+		if (chord_squared <= limit) {
+			result.push_back({ order_[mid], ChordToDistance(chord_squared) });
+		}
+
+		const double diff = query.xyz[axis] - point.xyz[axis];
+		const int next_axis = (axis + 1) % DIMENSIONS;
+		if (diff < 0 || diff * diff <= limit) {
+			SearchInRadius(lo, mid, next_axis, query, limit, result);
+		}
+		if (diff >= 0 || diff * diff <= limit) {
+			SearchInRadius(mid + 1, hi, next_axis, query, limit, result);
+		}
+	}
+
+	std::vector<Neighbor> SpatialIndex::FindNearest(Coordinates center, size_t count) const {
+		std::vector<Neighbor> result;
+		if (count == 0 || order_.empty()) {
+			return result;
+		}
+
+		//max-heap by squared chord length, the farthest candidate is on top
+		std::vector<Candidate> heap;
+		heap.reserve(std::min(count, order_.size()));
+		SearchNearest(0, order_.size(), 0, ToPoint(ToSpherePoint(center)), count, heap);
+
+		result.reserve(heap.size());
+		for (const auto& [chord_squared, id] : heap) {
+			result.push_back({ id, ChordToDistance(chord_squared) });
+		}
+		std::sort(result.begin(), result.end(), NeighborLess);
+		return result;
+	}
+
+	std::vector<Neighbor> SpatialIndex::FindInRadius(Coordinates center, double radius) const {
+		std::vector<Neighbor> result;
+		if (radius < 0 || order_.empty()) {
+			return result;
+		}
+		const double chord = 2.0 * std::sin(std::min(radius / EARTH_RADIUS, PI) / 2.0);
+		SearchInRadius(0, order_.size(), 0, ToPoint(ToSpherePoint(center)), chord * chord, result);
+
+		std::sort(result.begin(), result.end(), NeighborLess);
+		return result;
+	}
+}
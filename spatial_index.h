@@ -0,0 +1,54 @@
+#pragma once
+
+#include "geo.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace geo {
+
+	struct Neighbor {
+		uint32_t id;
+		double distance;
+	};
+
+	// Статическое k-d дерево по точкам на сфере.
+	// Точки берутся в декартовых координатах на единичной сфере: длина хорды монотонна
+	// по отношению к расстоянию по дуге, поэтому отсечение по плоскостям разбиения точное.
+	// Дерево неявное: узел отрезка [lo, hi) лежит в середине, левое поддерево слева от него,
+	// ось разбиения чередуется по глубине. Хранится только порядок id, его и сериализуем.
+	class SpatialIndex {
+	public:
+		void Build(const SpherePoints& points);
+		// Восстанавливает дерево по сохранённому порядку id.
+		// Бросает std::runtime_error, если order не перестановка id точек
+		void Assign(std::vector<uint32_t> order, const SpherePoints& points);
+
+		const std::vector<uint32_t>& GetOrder() const { return order_; }
+		bool IsEmpty() const { return order_.empty(); }
+
+		// count ближайших точек, отсортированных по возрастанию расстояния
+		std::vector<Neighbor> FindNearest(Coordinates center, size_t count) const;
+		// Точки не дальше radius метров, отсортированные по возрастанию расстояния
+		std::vector<Neighbor> FindInRadius(Coordinates center, double radius) const;
+
+	private:
+		struct Point {
+			double xyz[3];
+		};
+
+		// Квадрат длины хорды и id точки
+		using Candidate = std::pair<double, uint32_t>;
+
+		std::vector<uint32_t> order_;
+		std::vector<Point> points_;
+
+		static Point ToPoint(SpherePoint point);
+		static double ChordSquared(const Point& lhs, const Point& rhs);
+		void BuildNode(size_t lo, size_t hi, int axis);
+		void FillPoints(const SpherePoints& points);
+		void SearchNearest(size_t lo, size_t hi, int axis, const Point& query, size_t count, std::vector<Candidate>& heap) const;
+		void SearchInRadius(size_t lo, size_t hi, int axis, const Point& query, double limit, std::vector<Neighbor>& result) const;
+	};
+}
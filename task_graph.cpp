@@ -0,0 +1,160 @@
+#include "task_graph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <iomanip>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+namespace tasks {
+
+	namespace {
+		using Clock = std::chrono::steady_clock;
+
+		double ToMilliseconds(Clock::duration duration) {
+			return std::chrono::duration<double, std::milli>(duration).count();
+		}
+	}
+
+	TaskGraph::TaskId TaskGraph::Add(std::string name, std::vector<TaskId> dependencies, std::function<void()> task) {
+		const TaskId id = tasks_.size();
+		for (TaskId dependency : dependencies) {
+			if (dependency >= id) {
+				throw std::invalid_argument("Task depends on a task added after it");
+			}
+			tasks_[dependency].dependents.push_back(id);
+		}
+		tasks_.push_back({ std::move(name), std::move(dependencies), {}, std::move(task), {} });
+		return id;
+	}
+
+	void TaskGraph::Run(size_t thread_count) {
+		std::mutex mutex;
+		std::condition_variable changed;
+		std::vector<size_t> pending(tasks_.size());
+		std::deque<TaskId> ready;
+		for (TaskId id = 0; id < tasks_.size(); ++id) {
+			pending[id] = tasks_[id].dependencies.size();
+			if (pending[id] == 0) {
+				ready.push_back(id);
+			}
+		}
+		size_t unfinished = tasks_.size();
+		std::exception_ptr error;
+		const auto run_start = Clock::now();
+
+		auto work = [&]() {
+			std::unique_lock lock(mutex);
+			while (true) {
+				changed.wait(lock, [&]() { return !ready.empty() || unfinished == 0 || error; });
+				if (unfinished == 0 || error) {
+					return;
+				}
+				const TaskId id = ready.front();
+				ready.pop_front();
+				lock.unlock();
+
+				const auto start = Clock::now();
+				std::exception_ptr task_error;
+				try {
+					tasks_[id].run();
+				}
+				catch (...) {
+					task_error = std::current_exception();
+				}
+				const auto finish = Clock::now();
+
+				lock.lock();
+				tasks_[id].timing = { ToMilliseconds(start - run_start), ToMilliseconds(finish - start) };
+				--unfinished;
+				if (task_error && !error) {
+					error = task_error;
+				}
+				for (TaskId dependent : tasks_[id].dependents) {
+					if (--pending[dependent] == 0) {
+						ready.push_back(dependent);
+					}
+				}
+				changed.notify_all();
+			}
+		};
+
+		std::vector<std::thread> workers;
+		const size_t worker_count = std::min(thread_count, tasks_.size());
+		for (size_t i = 1; i < worker_count; ++i) {
+			workers.emplace_back(work);
+		}
+		work();
+		for (auto& worker : workers) {
+			worker.join();
+		}
+		total_ms_ = ToMilliseconds(Clock::now() - run_start);
+
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+
+	std::vector<TaskGraph::TaskId> TaskGraph::GetCriticalPath() const {
+		std::vector<TaskId> path;
+		if (tasks_.empty()) {
+			return path;
+		}
+
+		//tasks are stored in topological order, so one pass finds the heaviest chain ending in each task
+		std::vector<double> chain_ms(tasks_.size());
+		std::vector<TaskId> previous(tasks_.size());
+		for (TaskId id = 0; id < tasks_.size(); ++id) {
+			previous[id] = id;
+			double longest = 0.0;
+			for (TaskId dependency : tasks_[id].dependencies) {
+				if (chain_ms[dependency] > longest || previous[id] == id) {
+					longest = chain_ms[dependency];
+					previous[id] = dependency;
+				}
+			}
+			chain_ms[id] = longest + tasks_[id].timing.duration_ms;
+		}
+
+		TaskId id = static_cast<TaskId>(std::max_element(chain_ms.begin(), chain_ms.end()) - chain_ms.begin());
+		path.push_back(id);
+		while (previous[id] != id) {
+			id = previous[id];
+			path.push_back(id);
+		}
+		std::reverse(path.begin(), path.end());
+		return path;
+	}
+
+	void TaskGraph::PrintTimings(std::ostream& output) const {
+		size_t name_width = 4;
+		for (const auto& task : tasks_) {
+			name_width = std::max(name_width, task.name.size());
+		}
+
+		const auto flags = output.flags();
+		const auto precision = output.precision();
+		output << std::fixed << std::setprecision(1);
+		output << std::left << std::setw(static_cast<int>(name_width)) << "task" << std::right
+			<< std::setw(12) << "start, ms" << std::setw(12) << "time, ms" << '\n';
+		for (const auto& task : tasks_) {
+			output << std::left << std::setw(static_cast<int>(name_width)) << task.name << std::right
+				<< std::setw(12) << task.timing.start_ms << std::setw(12) << task.timing.duration_ms << '\n';
+		}
+
+		double critical_ms = 0.0;
+		output << "critical path:";
+		for (TaskId id : GetCriticalPath()) {
+			output << ' ' << tasks_[id].name;
+			critical_ms += tasks_[id].timing.duration_ms;
+		}
+		output << " (" << critical_ms << " ms of " << total_ms_ << " ms total)\n";
+		output.flags(flags);
+		output.precision(precision);
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace tasks {
+
+	// Граф задач с зависимостями, выполняемый на пуле потоков.
+	// Задача запускается, как только завершены все задачи, от которых она зависит.
+	// Для каждой задачи запоминается время начала и длительность, по ним строится
+	// критический путь - цепочка зависимостей, которая определяет общее время работы
+	class TaskGraph {
+	public:
+		using TaskId = size_t;
+
+		struct Timing {
+			// Отсчитывается от начала Run
+			double start_ms = 0.0;
+			double duration_ms = 0.0;
+		};
+
+		// Задачи, от которых зависит новая, должны быть добавлены раньше неё
+		TaskId Add(std::string name, std::vector<TaskId> dependencies, std::function<void()> task);
+
+		// Выполняет все задачи на thread_count потоках, включая вызывающий. Если задача бросила
+		// исключение, новые задачи не запускаются, а исключение пробрасывается после остановки потоков
+		void Run(size_t thread_count);
+
+		const std::string& GetName(TaskId id) const { return tasks_.at(id).name; }
+		const Timing& GetTiming(TaskId id) const { return tasks_.at(id).timing; }
+		double GetTotalTime() const { return total_ms_; }
+		// Цепочка зависимых задач с наибольшей суммарной длительностью, от первой к последней
+		std::vector<TaskId> GetCriticalPath() const;
+		// Время каждой задачи и критический путь
+		void PrintTimings(std::ostream& output) const;
+
+	private:
+		struct Task {
+			std::string name;
+			std::vector<TaskId> dependencies;
+			std::vector<TaskId> dependents;
+			std::function<void()> run;
+			Timing timing;
+		};
+
+		std::vector<Task> tasks_;
+		double total_ms_ = 0.0;
+	};
+}
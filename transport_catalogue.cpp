@@ -1,5 +1,7 @@
 #include "transport_catalogue.h"
 
+#include <stdexcept>
+
 namespace trans_ctl {
 	void TransportCatalogue::SetStopsLength(Stop* first_stop, Stop* second_stop, double distance)
 	{
@@ -8,6 +10,12 @@ namespace trans_ctl {
 
 	double TransportCatalogue::GetStopsLength(Stop* first_stop, Stop* second_stop) const
 	{
+		if (lengths_offsets_view_.begin() != nullptr) {
+			if (const double* distance = FindViewedLength(first_stop->id, second_stop->id)) { return *distance; }
+			if (first_stop == second_stop) { return 0.0; }
+			if (const double* distance = FindViewedLength(second_stop->id, first_stop->id)) { return *distance; }
+			throw std::out_of_range("No distance between stops");
+		}
 		if (first_stop == second_stop && segments_map_.count({ first_stop, second_stop }) == 0) { return 0.0; }
 		else if (segments_map_.count({ first_stop, second_stop }) == 0)
 		{
@@ -16,36 +24,155 @@ namespace trans_ctl {
 		return segments_map_.at({ first_stop, second_stop });
 	}
 
-	std::unordered_map<std::pair<Stop*, Stop*>, double, StopsHasher> TransportCatalogue::GetAllStopLengths() const {
+	void TransportCatalogue::ViewStopsLengths(StopIdsRange offsets, StopIdsRange stop_ids, DistancesRange distances)
+	{
+		lengths_offsets_view_ = offsets;
+		lengths_stops_view_ = stop_ids;
+		lengths_view_ = distances;
+	}
+
+	void TransportCatalogue::ForEachStopsLength(const std::function<void(uint32_t, uint32_t, double)>& callback) const
+	{
+		if (lengths_offsets_view_.begin() == nullptr) {
+			for (const auto& [stops, distance] : segments_map_) {
+				callback(stops.first->id, stops.second->id, distance);
+			}
+			return;
+		}
+		const uint32_t* offsets = lengths_offsets_view_.begin();
+		const size_t rows = lengths_offsets_view_.end() - offsets;
+		for (uint32_t from_id = 0; from_id + 1 < rows; ++from_id) {
+			for (uint32_t i = offsets[from_id]; i < offsets[from_id + 1]; ++i) {
+				callback(from_id, lengths_stops_view_.begin()[i], lengths_view_.begin()[i]);
+			}
+		}
+	}
+
+	const double* TransportCatalogue::FindViewedLength(uint32_t from_id, uint32_t to_id) const
+	{
+		const uint32_t* offsets = lengths_offsets_view_.begin();
+		if (from_id + 1 >= static_cast<size_t>(lengths_offsets_view_.end() - offsets)) {
+			return nullptr;
+		}
+		//neighbours of a stop are sorted by id
+		const uint32_t* first = lengths_stops_view_.begin() + offsets[from_id];
+		const uint32_t* last = lengths_stops_view_.begin() + offsets[from_id + 1];
+		const uint32_t* it = std::lower_bound(first, last, to_id);
+		if (it == last || *it != to_id) {
+			return nullptr;
+		}
+		return lengths_view_.begin() + (it - lengths_stops_view_.begin());
+	}
+
+	const std::unordered_map<std::pair<Stop*, Stop*>, double, StopsHasher>& TransportCatalogue::GetAllStopLengths() const {
 		return segments_map_;
 	}
 
-	void TransportCatalogue::AddStop(const Stop& stop)
+	void TransportCatalogue::AddStop(Stop stop)
 	{
-		stops_.push_back(stop);
-		stops_map_.insert({ stops_.back().name, &stops_.back() });
+		stop.id = static_cast<uint32_t>(stops_.size());
+		stops_points_.Add(stop.coordinates);
+		stops_.push_back(std::move(stop));
+		if (!stops_names_.IsBuilt()) {
+			stops_map_.insert({ stops_.back().name, &stops_.back() });
+		}
 	}
 
 	Stop* TransportCatalogue::FindStop(const std::string_view stop_name) const
 	{
-		if (stops_map_.count(stop_name) == 0) return nullptr;
-		return stops_map_.at(stop_name);
+		if (stops_names_.IsBuilt()) {
+			auto id = stops_names_.Find(stop_name);
+			return id ? const_cast<Stop*>(&stops_[*id]) : nullptr;
+		}
+		auto it = stops_map_.find(stop_name);
+		if (it == stops_map_.end()) return nullptr;
+		return it->second;
+	}
+
+	void TransportCatalogue::AddBus(Bus bus)
+	{
+		bus.id = static_cast<uint32_t>(routes_.size());
+		routes_.push_back(std::move(bus));
+		if (!buses_names_.IsBuilt()) {
+			routes_info_.insert({ routes_.back().name, &routes_.back() });
+		}
+	}
+
+	const Bus& TransportCatalogue::GetBusById(uint32_t id) const
+	{
+		return routes_[id];
 	}
 
-	void TransportCatalogue::AddBus(const Bus& bus)
+	void TransportCatalogue::BuildStopBuses()
 	{
-		routes_.push_back(bus);
-		routes_info_.insert({ routes_.back().name, &routes_.back() });
+		//rank buses by name once, so the pairs below are sorted by integers only
+		std::vector<uint32_t> by_name(routes_.size());
+		for (uint32_t i = 0; i < by_name.size(); ++i) { by_name[i] = i; }
+		std::sort(by_name.begin(), by_name.end(), [this](uint32_t lhs, uint32_t rhs) {
+			return routes_[lhs].name < routes_[rhs].name;
+		});
+		std::vector<uint32_t> rank(routes_.size());
+		for (uint32_t i = 0; i < by_name.size(); ++i) { rank[by_name[i]] = i; }
+
+		//(stop id, bus rank) pairs packed into one integer
+		std::vector<uint64_t> pairs;
+		for (const auto& bus : routes_) {
+			for (const auto& stop_ptr : bus.stops) {
+				pairs.push_back((static_cast<uint64_t>(stop_ptr->id) << 32) | rank[bus.id]);
+			}
+		}
+		std::sort(pairs.begin(), pairs.end());
+		pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
 
-		for (const auto& stop_ptr : bus.stops) {
-			stops_info_[stop_ptr].insert(&routes_.back());
+		stop_buses_offsets_.assign(stops_.size() + 1, 0);
+		stop_buses_.clear();
+		stop_buses_.reserve(pairs.size());
+		for (uint64_t pair : pairs) {
+			++stop_buses_offsets_[(pair >> 32) + 1];
+			stop_buses_.push_back(by_name[static_cast<uint32_t>(pair)]);
 		}
+		for (size_t i = 1; i < stop_buses_offsets_.size(); ++i) {
+			stop_buses_offsets_[i] += stop_buses_offsets_[i - 1];
+		}
+	}
+
+	void TransportCatalogue::SetStopBuses(std::vector<uint32_t> offsets, std::vector<uint32_t> buses)
+	{
+		stop_buses_offsets_ = std::move(offsets);
+		stop_buses_ = std::move(buses);
+		stop_buses_viewed_ = false;
+	}
+
+	void TransportCatalogue::ViewStopBuses(BusIdsRange offsets, BusIdsRange buses)
+	{
+		stop_buses_offsets_.clear();
+		stop_buses_.clear();
+		stop_buses_offsets_view_ = offsets;
+		stop_buses_view_ = buses;
+		stop_buses_viewed_ = true;
+	}
+
+	BusIdsRange TransportCatalogue::GetStopBuses(uint32_t stop_id) const
+	{
+		//pointers into owned vectors are taken on every call, so they survive moving the catalogue
+		const uint32_t* offsets = stop_buses_viewed_ ? stop_buses_offsets_view_.begin() : stop_buses_offsets_.data();
+		const size_t offsets_count = stop_buses_viewed_ ? stop_buses_offsets_view_.end() - offsets : stop_buses_offsets_.size();
+		if (stop_id + 1 >= offsets_count) {
+			return { nullptr, nullptr };
+		}
+		const uint32_t* data = stop_buses_viewed_ ? stop_buses_view_.begin() : stop_buses_.data();
+		return { data + offsets[stop_id], data + offsets[stop_id + 1] };
 	}
 
 	Bus* TransportCatalogue::FindBus(const std::string_view bus_name) const
 	{
-		if (routes_info_.count(bus_name) == 0) return nullptr;
-		return routes_info_.at(bus_name);
+		if (buses_names_.IsBuilt()) {
+			auto id = buses_names_.Find(bus_name);
+			return id ? const_cast<Bus*>(&routes_[*id]) : nullptr;
+		}
+		auto it = routes_info_.find(bus_name);
+		if (it == routes_info_.end()) return nullptr;
+		return it->second;
 	}
 
 	bool TransportCatalogue::BusIsEmpty(Bus* bus) const {
@@ -57,14 +184,14 @@ namespace trans_ctl {
 		return stops_.size();
 	}
 
-	std::unordered_map<std::string_view, Bus*> TransportCatalogue::GetAllRoutes() const
+	const std::deque<Stop>& TransportCatalogue::GetStops() const
 	{
-		return routes_info_;
+		return stops_;
 	}
-	
-	std::unordered_map<std::string_view, Stop*> TransportCatalogue::GetAllStops() const
+
+	const std::deque<Bus>& TransportCatalogue::GetBuses() const
 	{
-		return stops_map_;
+		return routes_;
 	}
 
 	BusStat* TransportCatalogue::ExecuteBusRequest(Bus* bus)
@@ -78,38 +205,139 @@ namespace trans_ctl {
 		return &bus->stat;
 	}
 
-	std::set<Bus*, BusCmp> TransportCatalogue::ExecuteStopRequest(Stop* stop) const
+	void TransportCatalogue::BuildNameIndexes()
 	{
-		std::set<Bus*, BusCmp> buses;
+		std::vector<std::pair<std::string_view, uint32_t>> names;
+		names.reserve(stops_.size());
+		for (const auto& stop : stops_) {
+			names.push_back({ stop.name, stop.id });
+		}
+		stops_names_.Build(std::move(names));
 
-		if (stop == nullptr || stops_info_.count(stop) == 0) {
-			return buses;
+		names.clear();
+		names.reserve(routes_.size());
+		for (const auto& bus : routes_) {
+			names.push_back({ bus.name, bus.id });
 		}
+		buses_names_.Build(std::move(names));
+	}
+
+	void TransportCatalogue::SetNameIndexes(std::string stops_index, std::string buses_index)
+	{
+		stops_names_.Assign(std::move(stops_index));
+		buses_names_.Assign(std::move(buses_index));
+	}
+
+	void TransportCatalogue::ViewNameIndexes(std::string_view stops_index, std::string_view buses_index)
+	{
+		stops_names_.View(stops_index);
+		buses_names_.View(buses_index);
+	}
+
+	const NameIndex& TransportCatalogue::GetStopsNameIndex() const
+	{
+		return stops_names_;
+	}
+
+	const NameIndex& TransportCatalogue::GetBusesNameIndex() const
+	{
+		return buses_names_;
+	}
+
+	std::vector<uint32_t> TransportCatalogue::FindStopsByPrefix(std::string_view prefix, size_t limit) const
+	{
+		return stops_names_.FindByPrefix(prefix, limit);
+	}
+
+	void TransportCatalogue::BuildSpatialIndex()
+	{
+		stops_index_.Build(stops_points_);
+	}
+
+	void TransportCatalogue::SetSpatialIndex(std::vector<uint32_t> order)
+	{
+		stops_index_.Assign(std::move(order), stops_points_);
+	}
+
+	const geo::SpatialIndex& TransportCatalogue::GetSpatialIndex() const
+	{
+		return stops_index_;
+	}
+
+	std::vector<geo::Neighbor> TransportCatalogue::FindNearestStops(geo::Coordinates coordinates, size_t count) const
+	{
+		return stops_index_.FindNearest(coordinates, count);
+	}
+
+	std::vector<geo::Neighbor> TransportCatalogue::FindStopsInRadius(geo::Coordinates coordinates, double radius) const
+	{
+		return stops_index_.FindInRadius(coordinates, radius);
+	}
+
+	const Stop& TransportCatalogue::GetStopById(uint32_t id) const
+	{
+		return stops_[id];
+	}
 
-		buses = stops_info_.at(stop);
-		return buses;
+	const geo::SpherePoints& TransportCatalogue::GetStopsPoints() const
+	{
+		return stops_points_;
+	}
+
+	BusIdsRange TransportCatalogue::ExecuteStopRequest(Stop* stop) const
+	{
+		if (stop == nullptr) {
+			return { nullptr, nullptr };
+		}
+		return GetStopBuses(stop->id);
 	}
 
 	BusStat* TransportCatalogue::CalcBusStat(Bus* route)
 	{
 		calc::RouteStops(route);
 		calc::RouteUniqueStops(route);
-		calc::RouteDistance(route);
+		calc::RouteDistance(*this, route);
 		calc::RouteLength(*this, route);
 
 		return &(*route).stat;
 	}
 
+	void TransportCatalogue::CalcAllBusStats()
+	{
+		for (Bus& bus : routes_) {
+			if (!bus.stops.empty()) {
+				CalcBusStat(&bus);
+			}
+		}
+	}
+
 	namespace calc {
-		void RouteDistance(Bus* route)
+		void RouteDistance(const TransportCatalogue& catalogue, Bus* route)
 		{
-			double route_distance = 0.0;
-			for (size_t i = 0; i < (*route).stops.size() - 1; ++i) {
-				auto stop_left_ptr = (*route).stops[i];
-				auto stop_right_ptr = (*route).stops[i + 1];
+			const auto& stops = (*route).stops;
+			if (stops.size() < 2) {
+				(*route).stat.route_distance = 0.0;
+				return;
+			}
 
-				route_distance += geo::ComputeDistance({ (*stop_left_ptr).coordinates.lat, (*stop_left_ptr).coordinates.lng },
-					{ (*stop_right_ptr).coordinates.lat, (*stop_right_ptr).coordinates.lng });
+			//gather cached stop points of the route, neighbours are the same arrays shifted by one
+			const auto& points = catalogue.GetStopsPoints();
+			const size_t size = stops.size();
+			std::vector<double> buffer(size * 4);
+			double* xs = buffer.data();
+			double* ys = xs + size;
+			double* zs = ys + size;
+			double* distances = zs + size;
+			for (size_t i = 0; i < size; ++i) {
+				xs[i] = points.x[stops[i]->id];
+				ys[i] = points.y[stops[i]->id];
+				zs[i] = points.z[stops[i]->id];
+			}
+			geo::ComputeDistances(xs, ys, zs, xs + 1, ys + 1, zs + 1, distances, size - 1);
+
+			double route_distance = 0.0;
+			for (size_t i = 0; i < size - 1; ++i) {
+				route_distance += distances[i];
 			}
 			if (!(*route).isCircleRoute) { route_distance *= 2; }
 
@@ -151,10 +379,10 @@ namespace trans_ctl {
 
 		void RouteUniqueStops(Bus* route)
 		{
-			Bus temp_route = (*route);
-			std::sort(temp_route.stops.begin(), temp_route.stops.end());
-			auto last = std::unique(temp_route.stops.begin(), temp_route.stops.end());
-			(*route).stat.unique_stops_count = (last - temp_route.stops.begin());
+			std::vector<Stop*> stops = (*route).stops;
+			std::sort(stops.begin(), stops.end());
+			auto last = std::unique(stops.begin(), stops.end());
+			(*route).stat.unique_stops_count = (last - stops.begin());
 		}
 	}
 }
\ No newline at end of file
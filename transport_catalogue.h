@@ -2,6 +2,9 @@
 
 #include "geo.h"
 #include "domain.h"
+#include "name_index.h"
+#include "ranges.h"
+#include "spatial_index.h"
 #include <string>
 #include <string_view>
 #include <deque>
@@ -9,43 +12,100 @@
 #include <set>
 #include <unordered_map>
 #include <algorithm>
+#include <functional>
 #include <utility>
 
 namespace trans_ctl {
 
+	using BusIdsRange = ranges::Range<const uint32_t*>;
+	using StopIdsRange = ranges::Range<const uint32_t*>;
+	using DistancesRange = ranges::Range<const double*>;
+
 	class TransportCatalogue {
 	public:
-		void AddStop(const Stop& stop);
+		void AddStop(Stop stop);
 		void SetStopsLength(Stop* first_stop, Stop* second_stop, double distance);
 		Stop* FindStop(const std::string_view stop_name) const;
-		void AddBus(const Bus& bus);
+		void AddBus(Bus bus);
 		Bus* FindBus(const std::string_view bus_name) const;
 		double GetStopsLength(Stop* first_stop, Stop* second_stop) const;
+		// Расстояния в формате CSR из отображённого файла базы: для остановки i соседи
+		// stop_ids[offsets[i]..offsets[i+1]) по возрастанию id и расстояния до них в том же порядке.
+		// Память должна жить дольше каталога
+		void ViewStopsLengths(StopIdsRange offsets, StopIdsRange stop_ids, DistancesRange distances);
+		// Все заданные расстояния (id от, id до, расстояние) - и из словаря, и из отображённого файла
+		void ForEachStopsLength(const std::function<void(uint32_t, uint32_t, double)>& callback) const;
 		size_t GetStopsCount() const;
-		std::unordered_map<std::string_view, Bus*> GetAllRoutes() const;
-		std::unordered_map<std::string_view, Stop*> GetAllStops() const;
-		std::unordered_map<std::pair<Stop*, Stop*>, double, StopsHasher> GetAllStopLengths() const;
+		const std::deque<Stop>& GetStops() const;
+		const std::deque<Bus>& GetBuses() const;
+		const std::unordered_map<std::pair<Stop*, Stop*>, double, StopsHasher>& GetAllStopLengths() const;
+		const Bus& GetBusById(uint32_t id) const;
 		bool BusIsEmpty(Bus* bus) const;
 
+		// Строит для каждой остановки отсортированный по имени список id маршрутов
+		void BuildStopBuses();
+		// Восстанавливает списки маршрутов остановок в формате CSR: buses[offsets[i]..offsets[i+1])
+		void SetStopBuses(std::vector<uint32_t> offsets, std::vector<uint32_t> buses);
+		// То же без копирования: списки остаются в отображённом файле базы
+		void ViewStopBuses(BusIdsRange offsets, BusIdsRange buses);
+		BusIdsRange GetStopBuses(uint32_t stop_id) const;
+
+		void BuildNameIndexes();
+		void SetNameIndexes(std::string stops_index, std::string buses_index);
+		void ViewNameIndexes(std::string_view stops_index, std::string_view buses_index);
+		const NameIndex& GetStopsNameIndex() const;
+		const NameIndex& GetBusesNameIndex() const;
+		// id остановок, имена которых начинаются с prefix, в алфавитном порядке
+		std::vector<uint32_t> FindStopsByPrefix(std::string_view prefix, size_t limit) const;
+
+		// Строит пространственный индекс по координатам остановок
+		void BuildSpatialIndex();
+		// Восстанавливает индекс по сохранённому порядку id, без перестроения дерева
+		void SetSpatialIndex(std::vector<uint32_t> order);
+		const geo::SpatialIndex& GetSpatialIndex() const;
+		std::vector<geo::Neighbor> FindNearestStops(geo::Coordinates coordinates, size_t count) const;
+		std::vector<geo::Neighbor> FindStopsInRadius(geo::Coordinates coordinates, double radius) const;
+		const Stop& GetStopById(uint32_t id) const;
+		// Точки остановок на единичной сфере, индекс - id остановки
+		const geo::SpherePoints& GetStopsPoints() const;
+
 		BusStat* ExecuteBusRequest(Bus* bus);
-		std::set<Bus*, BusCmp> ExecuteStopRequest(Stop* stop) const;
+		BusIdsRange ExecuteStopRequest(Stop* stop) const;
 
 		BusStat* CalcBusStat(Bus* route);
+		// Считает статистику всех маршрутов заранее, чтобы сохранить её в базу
+		void CalcAllBusStats();
 
 	private:
 		std::deque<Stop> stops_;
+		geo::SpherePoints stops_points_;
+		// Словари имён заполняются только пока каталог строится, после BuildNameIndexes
+		// или SetNameIndexes поиск по имени идёт через неизменяемые индексы
 		std::unordered_map<std::string_view, Stop*> stops_map_;
-		std::unordered_map<Stop*, std::set<Bus*, BusCmp>> stops_info_;
+		std::vector<uint32_t> stop_buses_offsets_;
+		std::vector<uint32_t> stop_buses_;
+		// Списки маршрутов и расстояния, которые читаются прямо из файла базы
+		bool stop_buses_viewed_ = false;
+		BusIdsRange stop_buses_offsets_view_{ nullptr, nullptr };
+		BusIdsRange stop_buses_view_{ nullptr, nullptr };
+		StopIdsRange lengths_offsets_view_{ nullptr, nullptr };
+		StopIdsRange lengths_stops_view_{ nullptr, nullptr };
+		DistancesRange lengths_view_{ nullptr, nullptr };
+		geo::SpatialIndex stops_index_;
+		NameIndex stops_names_;
+		NameIndex buses_names_;
 
 		std::deque<Bus> routes_;
 		std::unordered_map<std::string_view, Bus*> routes_info_;
 
 		std::unordered_map<std::pair<Stop*, Stop*>, double, StopsHasher> segments_map_;
+
+		const double* FindViewedLength(uint32_t from_id, uint32_t to_id) const;
 	};
 
 	namespace calc {
 		void RouteLength(TransportCatalogue& catalogue, Bus* route);
-		void RouteDistance(Bus* route);
+		void RouteDistance(const TransportCatalogue& catalogue, Bus* route);
 		void RouteStops(Bus* route);
 		void RouteUniqueStops(Bus* route);
 	}
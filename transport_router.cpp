@@ -1,16 +1,95 @@
 #include "transport_router.h"
 
+#include <stdexcept>
+
 namespace transport_router {
 
+	void EdgesInfo::Reserve(size_t count) {
+		kinds.reserve(count);
+		bus_ids.reserve(count);
+		stop_ids.reserve(count);
+		span_counts.reserve(count);
+	}
+
+	void EdgesInfo::Add(const EdgeInfo& info) {
+		kinds.push_back(info.kind);
+		bus_ids.push_back(info.bus_id);
+		stop_ids.push_back(info.stop_id);
+		span_counts.push_back(info.span_count);
+	}
+
 	void TRouter::Build() {
 
+		BuildGraph();
+		router_ptr_ = std::make_unique<graph::Router<double>>(graph_);
+	}
+
+	void TRouter::BuildGraph() {
+
 		graph::DirectedWeightedGraph<double> graph(catalogue_.GetStopsCount() * 2);
 
 		AddStopsToGraph(graph);
 		AddRoutesToGraph(graph);
 
 		graph_ = std::move(graph);
-		router_ptr_ = std::make_unique<graph::Router<double>>(graph_);
+	}
+
+	void TRouter::BuildGraph(const graph::DirectedWeightedGraph<double>& previous_graph, const TRouter& previous,
+		const std::vector<uint32_t>& new_stop_ids, const std::vector<uint32_t>& previous_bus_ids) {
+
+		graph::DirectedWeightedGraph<double> graph(catalogue_.GetStopsCount() * 2);
+		AddStopsToGraph(graph);
+
+		//edges of a bus are added in one run, so each previous bus owns a contiguous range
+		const EdgesInfo& previous_info = previous.GetEdgesInfo();
+		std::vector<std::pair<size_t, size_t>> previous_ranges;
+		for (size_t id = 0; id < previous_info.Size(); ++id) {
+			if (previous_info.kinds[id] != EdgeKind::BUS) {
+				continue;
+			}
+			const uint32_t bus_id = previous_info.bus_ids[id];
+			if (bus_id >= previous_ranges.size()) {
+				previous_ranges.resize(bus_id + 1, { 0, 0 });
+			}
+			if (previous_ranges[bus_id].first == previous_ranges[bus_id].second) {
+				previous_ranges[bus_id].first = id;
+			}
+			previous_ranges[bus_id].second = id + 1;
+		}
+
+		//previous vertex -> vertex of the same stop now, stops of a reused bus are never removed
+		std::vector<size_t> vertices(previous_graph.GetVertexCount(), 0);
+		for (uint32_t stop_id = 0; stop_id < new_stop_ids.size(); ++stop_id) {
+			if (new_stop_ids[stop_id] != NO_PREVIOUS) {
+				vertices.at(previous.GetStopsIds().at(stop_id)) = stops_ids[new_stop_ids[stop_id]];
+				vertices.at(previous.GetWaitingStopsIds().at(stop_id)) = waiting_stops_ids[new_stop_ids[stop_id]];
+			}
+		}
+
+		for (const auto& bus : catalogue_.GetBuses()) {
+			const uint32_t previous_id = previous_bus_ids[bus.id];
+			if (previous_id == NO_PREVIOUS) {
+				AddCircleRoute(bus.id, bus.stops, graph);
+				if (!bus.isCircleRoute) {
+					std::vector<trans_ctl::Stop*> reverse_stops = { bus.stops.rbegin(), bus.stops.rend() };
+					AddCircleRoute(bus.id, reverse_stops, graph);
+				}
+				continue;
+			}
+			if (previous_id >= previous_ranges.size()) {
+				continue;
+			}
+			for (size_t id = previous_ranges[previous_id].first; id < previous_ranges[previous_id].second; ++id) {
+				const auto& edge = previous_graph.GetEdge(id);
+				graph.AddEdge({ vertices[edge.from], vertices[edge.to], edge.weight });
+				EdgeInfo info = previous_info.Get(id);
+				info.bus_id = bus.id;
+				info.stop_id = new_stop_ids[info.stop_id];
+				edges_info_.Add(info);
+			}
+		}
+
+		graph_ = std::move(graph);
 	}
 
 	void TRouter::ConnectGraph(graph::DirectedWeightedGraph<double>& graph) {
@@ -22,31 +101,32 @@ namespace transport_router {
 	void TRouter::AddStopsToGraph(graph::DirectedWeightedGraph<double>& graph)
 	{
 		size_t id = 0;
-		auto stops = catalogue_.GetAllStops();
-		for (const auto& stop : stops) {
+		stops_ids.assign(catalogue_.GetStopsCount(), 0);
+		waiting_stops_ids.assign(catalogue_.GetStopsCount(), 0);
+		//vertices and edges follow stop ids, so the same catalogue always gives the same graph
+		for (const auto& stop : catalogue_.GetStops()) {
 			//create stop & waiting stop
-			stops_ids[stop.first] = id;
-			waiting_stops_ids[stop.first] = id + 1;
-			auto edge_id = graph.AddEdge({ id + 1, id, static_cast<double>(routing_settings_.bus_wait_time) });
-			id_to_bus_stop[edge_id] = { "waiting", stop.first, 1 };
+			stops_ids[stop.id] = id;
+			waiting_stops_ids[stop.id] = id + 1;
+			//edge ids are dense, so the metadata of edge k is the k-th entry
+			graph.AddEdge({ id + 1, id, static_cast<double>(routing_settings_.bus_wait_time) });
+			edges_info_.Add({ EdgeKind::WAIT, 0, stop.id, 1 });
 			id += 2;
 		}
 	}
 
 	void TRouter::AddRoutesToGraph(graph::DirectedWeightedGraph<double>& graph)
 	{
-		auto routes = catalogue_.GetAllRoutes();
-
-		for (const auto& [bus_name, bus_ptr] : routes) {
-			AddCircleRoute(bus_name, bus_ptr->stops, graph);
-			if (!bus_ptr->isCircleRoute) {
-				std::vector<trans_ctl::Stop*> reverse_stops = { bus_ptr->stops.rbegin(), bus_ptr->stops.rend() };
-				AddCircleRoute(bus_name, reverse_stops, graph);
+		for (const auto& bus : catalogue_.GetBuses()) {
+			AddCircleRoute(bus.id, bus.stops, graph);
+			if (!bus.isCircleRoute) {
+				std::vector<trans_ctl::Stop*> reverse_stops = { bus.stops.rbegin(), bus.stops.rend() };
+				AddCircleRoute(bus.id, reverse_stops, graph);
 			}
 		}
 	}
 
-	void TRouter::AddCircleRoute(std::string_view bus_name, std::vector<trans_ctl::Stop*> stops, graph::DirectedWeightedGraph<double>& graph) {
+	void TRouter::AddCircleRoute(uint32_t bus_id, const std::vector<trans_ctl::Stop*>& stops, graph::DirectedWeightedGraph<double>& graph) {
 		std::vector<double> times(stops.size() - 1);
 
 		for (int i = 0; i < stops.size() - 1; ++i) {
@@ -54,14 +134,14 @@ namespace transport_router {
 		}
 
 		for (int i = 1, j = 0; j < stops.size() - 1;) {
-			auto first_stop_id = stops_ids.at(stops[j]->name);
-			auto second_stop_id = waiting_stops_ids.at(stops[i]->name);
+			auto first_stop_id = stops_ids[stops[j]->id];
+			auto second_stop_id = waiting_stops_ids[stops[i]->id];
 			double route_time = 0.0;
 			for (int it = j; it < i; ++it) {
 				route_time += times[it];
 			}
-			auto edge_id = graph.AddEdge({ first_stop_id, second_stop_id, route_time });
-			id_to_bus_stop[edge_id] = { bus_name, std::string_view(stops[j]->name), i - j };
+			graph.AddEdge({ first_stop_id, second_stop_id, route_time });
+			edges_info_.Add({ EdgeKind::BUS, bus_id, stops[j]->id, static_cast<uint32_t>(i - j) });
 			++i;
 			if (i == stops.size()) {
 				++j;
@@ -72,8 +152,19 @@ namespace transport_router {
 
 	std::optional<graph::Router<double>::RouteInfo> TRouter::BuildRoute(const std::string_view& from, const std::string_view& to) const
 	{
-		auto from_id = waiting_stops_ids.at(from);
-		auto to_id = waiting_stops_ids.at(to);
+		const trans_ctl::Stop* from_stop = catalogue_.FindStop(from);
+		const trans_ctl::Stop* to_stop = catalogue_.FindStop(to);
+		if (from_stop == nullptr || to_stop == nullptr) {
+			throw std::out_of_range("Unknown stop");
+		}
+
+		return BuildRoute(from_stop->id, to_stop->id);
+	}
+
+	std::optional<graph::Router<double>::RouteInfo> TRouter::BuildRoute(uint32_t from_stop_id, uint32_t to_stop_id) const
+	{
+		auto from_id = waiting_stops_ids.at(from_stop_id);
+		auto to_id = waiting_stops_ids.at(to_stop_id);
 
 		return router_ptr_->BuildRoute(from_id, to_id);
 	}
@@ -3,6 +3,7 @@
 #include "domain.h"
 #include "transport_catalogue.h"
 #include "router.h"
+#include <cstdint>
 #include <unordered_map>
 #include <vector>
 #include <iterator>
@@ -11,45 +12,81 @@
 
 namespace transport_router {
 
-struct EdgeIdtoBus {
-	std::string_view bus_name;
-	std::string_view stop_name;
-	int span_count = 0;
+enum class EdgeKind : uint8_t {
+	WAIT,
+	BUS,
+};
+
+// Сведения об одном ребре графа
+struct EdgeInfo {
+	EdgeKind kind = EdgeKind::WAIT;
+	// У ребра ожидания не используется
+	uint32_t bus_id = 0;
+	// Остановка, с которой начинается ребро
+	uint32_t stop_id = 0;
+	uint32_t span_count = 0;
+};
+
+// Сведения о рёбрах графа в виде параллельных массивов, индекс - id ребра
+struct EdgesInfo {
+	std::vector<EdgeKind> kinds;
+	std::vector<uint32_t> bus_ids;
+	std::vector<uint32_t> stop_ids;
+	std::vector<uint32_t> span_counts;
+
+	size_t Size() const { return kinds.size(); }
+	void Reserve(size_t count);
+	void Add(const EdgeInfo& info);
+	EdgeInfo Get(size_t id) const { return { kinds[id], bus_ids[id], stop_ids[id], span_counts[id] }; }
 };
 
 class TRouter {
 public:
+	// Нет соответствия в прежней базе: остановка удалена, маршрут новый или изменён
+	static constexpr uint32_t NO_PREVIOUS = UINT32_MAX;
+
 	TRouter(Routing_settings routing_settings, trans_ctl::TransportCatalogue& catalogue) :
 		routing_settings_(routing_settings), catalogue_(catalogue), 
-		waiting_stops_ids({}), stops_ids({}), id_to_bus_stop({}) {}
+		waiting_stops_ids({}), stops_ids({}), edges_info_({}) {}
 
+	// Вершины остановок и вершины ожидания на них заданы по id остановки
 	TRouter(Routing_settings routing_settings, trans_ctl::TransportCatalogue& catalogue,
-		std::unordered_map<std::string_view, size_t> waiting_stops_ids, std::unordered_map<std::string_view, size_t> stops_ids, 
-		std::unordered_map<size_t, EdgeIdtoBus> id_to_bus_stop) :
+		std::vector<size_t> waiting_stops_ids, std::vector<size_t> stops_ids, 
+		EdgesInfo edges_info) :
 		routing_settings_(routing_settings), catalogue_(catalogue), 
-		waiting_stops_ids(waiting_stops_ids), stops_ids(stops_ids), id_to_bus_stop(id_to_bus_stop) {}
+		waiting_stops_ids(std::move(waiting_stops_ids)), stops_ids(std::move(stops_ids)), edges_info_(std::move(edges_info)) {}
 
 	void Build();
+	// Строит только граф и сведения о рёбрах, без таблицы кратчайших путей.
+	// Этого достаточно для сохранения в базу: таблицу строит загрузка базы
+	void BuildGraph();
+	// То же с рёбрами маршрутов из графа прежней базы: маршрут с previous_bus_ids[id] != NO_PREVIOUS
+	// не изменился, и его рёбра копируются с новыми вершинами, остальные строятся заново.
+	// new_stop_ids - новый id каждой остановки прежней базы, previous - её маршрутизатор без таблицы путей
+	void BuildGraph(const graph::DirectedWeightedGraph<double>& previous_graph, const TRouter& previous,
+		const std::vector<uint32_t>& new_stop_ids, const std::vector<uint32_t>& previous_bus_ids);
 	void ConnectGraph(graph::DirectedWeightedGraph<double>& graph);
 	std::optional<graph::Router<double>::RouteInfo> BuildRoute(const std::string_view& from, const std::string_view& to) const;
-	graph::DirectedWeightedGraph<double> GetGraph() const { return graph_; }
-	EdgeIdtoBus GetEdgeInfo(size_t id) const { return id_to_bus_stop.at(id); }
-	std::unordered_map<std::string_view, size_t> GetWaitingStopsIds() const { return waiting_stops_ids; }
-	std::unordered_map<std::string_view, size_t> GetStopsIds() const { return stops_ids; }
-	std::unordered_map<size_t, EdgeIdtoBus> GetEdgeIdMap() const { return id_to_bus_stop; }
+	std::optional<graph::Router<double>::RouteInfo> BuildRoute(uint32_t from_stop_id, uint32_t to_stop_id) const;
+	const graph::DirectedWeightedGraph<double>& GetGraph() const { return graph_; }
+	EdgeInfo GetEdgeInfo(size_t id) const { return edges_info_.Get(id); }
+	const std::vector<size_t>& GetWaitingStopsIds() const { return waiting_stops_ids; }
+	const std::vector<size_t>& GetStopsIds() const { return stops_ids; }
+	const EdgesInfo& GetEdgesInfo() const { return edges_info_; }
 
 private:
 	Routing_settings routing_settings_;
 	trans_ctl::TransportCatalogue& catalogue_;
 	graph::DirectedWeightedGraph<double> graph_;
-	std::unordered_map<std::string_view, size_t> waiting_stops_ids;
-	std::unordered_map<std::string_view, size_t> stops_ids;
-	std::unordered_map<size_t, EdgeIdtoBus> id_to_bus_stop;
+	// Индекс - id остановки, значение - вершина графа
+	std::vector<size_t> waiting_stops_ids;
+	std::vector<size_t> stops_ids;
+	EdgesInfo edges_info_;
 	std::unique_ptr<graph::Router<double>> router_ptr_ = nullptr;
 
 	void AddStopsToGraph(graph::DirectedWeightedGraph<double>& graph);
 	void AddRoutesToGraph(graph::DirectedWeightedGraph<double>& graph);
-	void AddCircleRoute(std::string_view bus_name, std::vector<trans_ctl::Stop*> stops, graph::DirectedWeightedGraph<double>& graph);
+	void AddCircleRoute(uint32_t bus_id, const std::vector<trans_ctl::Stop*>& stops, graph::DirectedWeightedGraph<double>& graph);
 };
 
 } // namespace transport_router